@@ -0,0 +1,352 @@
+// read is POSIX, not C99
+#define _POSIX_C_SOURCE 200112L
+
+#include "adaptive.h"
+#include "histogram.h"
+#include "stats.h"
+#include <unistd.h>
+
+// Size of the buffer decoded bytes are collected in
+#define ADAPTOUT (1 << 16)
+
+// Longest code: a path through a tree of MAXSYMBOLS leaves and a raw symbol
+#define ADAPTCODEBITS (MAXSYMBOLS + ADAPTRAWBITS)
+
+// Most bytes of an unfinished code that are kept for the next read
+#define ADAPTCARRY ((ADAPTCODEBITS + 7) / 8)
+
+void initAdapt(ADAPTTREE *t)
+{
+    int root = ADAPTNODES - 1;
+    t->node[root].weight = 0;
+    t->node[root].parent = -1;
+    t->node[root].left = -1;
+    t->node[root].right = -1;
+    t->node[root].symbol = -1;
+    t->nyt = root;
+    for (int i = 0; i < MAXSYMBOLS; i++)
+        t->leaf[i] = -1;
+}
+
+// Points the children (or the leaf map) of the node at i back to i
+static void adoptNode(ADAPTTREE *t, int i)
+{
+    ADAPTNODE *n = &t->node[i];
+    if (n->left != -1)
+    {
+        t->node[n->left].parent = i;
+        t->node[n->right].parent = i;
+    }
+    else if (n->symbol >= 0)
+        t->leaf[n->symbol] = i;
+    else
+        t->nyt = i;
+}
+
+// Swaps the subtrees at two positions, which keep their parents
+static void swapNodes(ADAPTTREE *t, int a, int b)
+{
+    ADAPTNODE tmp = t->node[a];
+    int parentA = t->node[a].parent;
+    t->node[a] = t->node[b];
+    t->node[a].parent = parentA;
+    tmp.parent = t->node[b].parent;
+    t->node[b] = tmp;
+    adoptNode(t, a);
+    adoptNode(t, b);
+}
+
+static void updateAdapt(ADAPTTREE *t, int symbol)
+{
+    int q = t->leaf[symbol];
+    if (q == -1)
+    {
+        // The NYT node becomes the parent of a new NYT node and a new leaf
+        int old = t->nyt;
+        for (int i = old - 2; i < old; i++)
+        {
+            t->node[i].weight = 0;
+            t->node[i].parent = old;
+            t->node[i].left = -1;
+            t->node[i].right = -1;
+            t->node[i].symbol = -1;
+        }
+        t->node[old].left = old - 2;
+        t->node[old].right = old - 1;
+        t->node[old - 1].symbol = symbol;
+        t->nyt = old - 2;
+        t->leaf[symbol] = old - 1;
+        q = old - 1;
+    }
+    while (q != -1)
+    {
+        // Move the node to the highest position of its weight first, so
+        // incrementing it keeps the weights in order
+        int leader = q;
+        while (leader + 1 < ADAPTNODES && t->node[leader + 1].weight == t->node[q].weight)
+            leader++;
+        if (leader != q && leader != t->node[q].parent)
+        {
+            swapNodes(t, q, leader);
+            q = leader;
+        }
+        t->node[q].weight++;
+        q = t->node[q].parent;
+    }
+}
+
+void encodeAdapt(ADAPTTREE *t, BITWRITER *bw, int symbol)
+{
+    int q = t->leaf[symbol] != -1 ? t->leaf[symbol] : t->nyt;
+    // The path is found from the leaf up, so collect it before writing it
+    unsigned char path[ADAPTNODES];
+    int depth = 0;
+    for (; t->node[q].parent != -1; q = t->node[q].parent)
+        path[depth++] = t->node[t->node[q].parent].right == q;
+    while (depth > 0)
+    {
+        int n = depth > 64 ? 64 : depth;
+        uint64_t bits = 0;
+        for (int i = 0; i < n; i++)
+            bits = (bits << 1) | path[--depth];
+        writeBits(bw, bits, n);
+    }
+    if (t->leaf[symbol] == -1)
+        writeBits(bw, (uint64_t)symbol, ADAPTRAWBITS);
+    updateAdapt(t, symbol);
+}
+
+int decodeAdapt(ADAPTTREE *t, BITREADER *br)
+{
+    int q = ADAPTNODES - 1;
+    while (t->node[q].left != -1)
+    {
+        if (!moreBits(br))
+            return -1;
+        q = peekBits(br, 1) ? t->node[q].right : t->node[q].left;
+        skipBits(br, 1);
+    }
+    int symbol = t->node[q].symbol;
+    if (q == t->nyt)
+    {
+        uint64_t v;
+        if (readBits(br, ADAPTRAWBITS, &v) == -1 || v > EOS || t->leaf[v] != -1)
+            return -1;
+        symbol = (int)v;
+    }
+    updateAdapt(t, symbol);
+    return symbol;
+}
+
+// Rebuilds the canonical codes of the periodic rebuild model from the counts
+static void rebuildCodes(uint64_t *counts, HUFFTREE *ht, int *len, uint64_t *bits)
+{
+    huffmanLengths(counts, len, ht, 0);
+    canonicalCodes(len, bits, MAXSYMBOLS);
+}
+
+void adaptiveCompress(FILE *in, FILE *out, int interval)
+{
+    fwrite(ADAPTMAGIC, 1, 4, out);
+    fputc(ADAPTVERSION, out);
+    writeU32(out, (uint32_t)interval);
+    unsigned char *buf = (unsigned char *)malloc(ADAPTIO);
+    ADAPTTREE *t = (ADAPTTREE *)malloc(sizeof(ADAPTTREE));
+    if (buf == NULL || t == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    BITWRITER bw;
+    openWriter(&bw, out);
+    // Every symbol starts with a count of 1, so every symbol has a code
+    uint64_t counts[MAXSYMBOLS];
+    int len[MAXSYMBOLS];
+    uint64_t bits[MAXSYMBOLS];
+    CODEENTRY table[MAXSYMBOLS];
+    int longest = 0;
+    HUFFTREE ht = {NULL, 0, -1, 0, NULL};
+    size_t since = 0;
+    if (interval > 0)
+    {
+        for (int i = 0; i < MAXSYMBOLS; i++)
+            counts[i] = 1;
+        rebuildCodes(counts, &ht, len, bits);
+        longest = encodeTable(table, len, bits, SYMBOLS);
+    }
+    else
+        initAdapt(t);
+    ssize_t n;
+    while ((n = read(fileno(in), buf, ADAPTIO)) != 0)
+    {
+        if (n == -1)
+        {
+            perror("Error reading input file");
+            exit(EXIT_FAILURE);
+        }
+        if (interval == 0)
+        {
+            for (ssize_t i = 0; i < n; i++)
+                encodeAdapt(t, &bw, buf[i]);
+        }
+        for (size_t i = 0; interval > 0 && i < (size_t)n;)
+        {
+            size_t k = (size_t)n - i < interval - since ? (size_t)n - i : interval - since;
+            writeSymbols(&bw, buf + i, k, table, longest);
+            countBuffer(buf + i, k, counts);
+            i += k;
+            since += k;
+            if (since == (size_t)interval)
+            {
+                rebuildCodes(counts, &ht, len, bits);
+                longest = encodeTable(table, len, bits, SYMBOLS);
+                since = 0;
+            }
+        }
+        flushWriter(&bw);
+    }
+    if (interval == 0)
+        encodeAdapt(t, &bw, EOS);
+    else
+        writeBits(&bw, bits[EOS], len[EOS]);
+    STATPAYLOAD(bw.bits);
+    closeWriter(&bw);
+    fflush(out);
+    freeTree(&ht);
+    free(t);
+    free(buf);
+}
+
+// Reads up to n bytes, less only at the end of the input
+static size_t readFull(int fd, unsigned char *p, size_t n)
+{
+    size_t got = 0;
+    while (got < n)
+    {
+        ssize_t k = read(fd, p + got, n - got);
+        if (k == -1)
+        {
+            perror("Error reading input file");
+            exit(EXIT_FAILURE);
+        }
+        if (k == 0)
+            break;
+        got += (size_t)k;
+    }
+    return got;
+}
+
+void adaptiveDecompress(FILE *in, FILE *out)
+{
+    // Like the compress side, read() returns whatever a pipe holds instead
+    // of waiting for a full buffer. The header is read the same way, so
+    // stdio buffers nothing ahead.
+    int fd = fileno(in);
+    unsigned char head[9];
+    if (readFull(fd, head, sizeof(head)) != sizeof(head) || memcmp(head, ADAPTMAGIC, 4) != 0 ||
+        head[4] != ADAPTVERSION)
+    {
+        fprintf(stderr, "Error: Input is not an adaptive stream\n");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t interval = ((uint32_t)head[5] << 24) | ((uint32_t)head[6] << 16) | ((uint32_t)head[7] << 8) | head[8];
+    unsigned char *data = (unsigned char *)malloc(ADAPTCARRY + ADAPTIO);
+    unsigned char *buf = (unsigned char *)malloc(ADAPTOUT);
+    ADAPTTREE *t = (ADAPTTREE *)malloc(sizeof(ADAPTTREE));
+    if (data == NULL || buf == NULL || t == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t counts[MAXSYMBOLS];
+    int len[MAXSYMBOLS];
+    uint64_t bits[MAXSYMBOLS];
+    HUFFTREE ht = {NULL, 0, -1, 0, NULL};
+    DECODETABLE dt;
+    uint32_t since = 0;
+    if (interval > 0)
+    {
+        for (int i = 0; i < MAXSYMBOLS; i++)
+            counts[i] = 1;
+        rebuildCodes(counts, &ht, len, bits);
+        tableFromLengths(&dt, len, MAXSYMBOLS);
+    }
+    else
+        initAdapt(t);
+    // The bytes of a code cut off by the end of a read, and how many bits
+    // of the first one were already decoded
+    size_t kept = 0;
+    int skip = 0;
+    int end = 0;
+    uint64_t payload = 0;
+    size_t used = 0;
+    while (!end)
+    {
+        ssize_t n = read(fd, data + kept, ADAPTIO);
+        if (n == -1)
+        {
+            perror("Error reading input file");
+            exit(EXIT_FAILURE);
+        }
+        size_t size = kept + (size_t)n;
+        BITREADER br;
+        openBufferReader(&br, data, size);
+        uint64_t unused;
+        readBits(&br, skip, &unused);
+        while (1)
+        {
+            BITREADER before = br;
+            int c = interval > 0 ? decodeSymbol(&dt, &br) : decodeAdapt(t, &br);
+            if (c == -1 && n > 0 && size * 8 - bitsRead(&before) < ADAPTCODEBITS)
+            {
+                // Both decoders fail before changing the model, so the code
+                // is decoded again once the rest of it is read
+                br = before;
+                break;
+            }
+            if (c == -1)
+            {
+                fprintf(stderr, "Error: Adaptive stream is truncated or corrupted\n");
+                exit(EXIT_FAILURE);
+            }
+            if (c == EOS)
+            {
+                end = 1;
+                break;
+            }
+            buf[used++] = (unsigned char)c;
+            if (used == ADAPTOUT)
+            {
+                fwrite(buf, 1, used, out);
+                used = 0;
+            }
+            if (interval > 0)
+            {
+                counts[c]++;
+                if (++since == interval)
+                {
+                    rebuildCodes(counts, &ht, len, bits);
+                    freeTable(&dt);
+                    tableFromLengths(&dt, len, MAXSYMBOLS);
+                    since = 0;
+                }
+            }
+        }
+        uint64_t at = bitsRead(&br);
+        payload += at - (uint64_t)skip;
+        kept = size - (size_t)(at / 8);
+        skip = (int)(at % 8);
+        memmove(data, data + at / 8, kept);
+        // Everything decoded so far goes out before waiting for more input
+        fwrite(buf, 1, used, out);
+        fflush(out);
+        used = 0;
+    }
+    STATPAYLOAD(payload);
+    if (interval > 0)
+        freeTable(&dt);
+    freeTree(&ht);
+    free(t);
+    free(buf);
+    free(data);
+}
@@ -0,0 +1,126 @@
+/**
+ * @file adaptive.h
+ * @brief Single-pass adaptive Huffman coding for live streams.
+ *
+ * The adaptive codecs need neither a probability file nor a first pass over
+ * the input: encoder and decoder start from the same empty model and update
+ * it the same way after every byte, so the code is learned on the fly and
+ * output can be written as soon as input arrives. Two models are available:
+ *
+ * - FGK adaptive Huffman: the tree is updated after every byte, keeping the
+ *   sibling property. A byte that was not seen before is sent as the code
+ *   of the "not yet transmitted" (NYT) node followed by its 9-bit value.
+ * - Periodic rebuild: canonical codes are rebuilt from the running counts
+ *   every `interval` bytes, which is much cheaper per byte and uses the
+ *   table-driven coders between rebuilds.
+ *
+ * An adaptive file consists of a 4 byte magic "HUFA", a 1 byte format
+ * version, the rebuild interval as a 32-bit big-endian integer (0 for FGK)
+ * and the bitstream, which ends with the end-of-stream symbol.
+ *
+ * @see bitio.h
+ * @see lookup.h
+ */
+
+#include "lookup.h"
+
+#ifndef ADAPTIVEH
+#define ADAPTIVEH
+
+/** Magic bytes at the start of every adaptive file. */
+#define ADAPTMAGIC "HUFA"
+
+/** Current version of the adaptive format. */
+#define ADAPTVERSION 1
+
+/** Number of nodes of an FGK tree: two per symbol and one NYT node. */
+#define ADAPTNODES (2 * MAXSYMBOLS + 1)
+
+/** Bits used to send a symbol the first time it is seen. */
+#define ADAPTRAWBITS 9
+
+/** Longest rebuild interval in KiB that can be given with `-k`. */
+#define ADAPTMAXKIB (1 << 20)
+
+/** Largest number of bytes read from the input at once. */
+#define ADAPTIO (1 << 14)
+
+/**
+ * @struct ADAPTNODE
+ * @brief A node of an FGK tree.
+ */
+typedef struct AdaptNode
+{
+    uint64_t weight; /**< Number of times the symbols below were seen */
+    int parent;      /**< Index of the parent node, -1 for the root */
+    int left;        /**< Index of the left child, -1 for a leaf */
+    int right;       /**< Index of the right child, -1 for a leaf */
+    int symbol;      /**< Symbol of a leaf, -1 for internal and NYT nodes */
+} ADAPTNODE;
+
+/**
+ * @struct ADAPTTREE
+ * @brief An FGK tree. Nodes are ordered by weight, the root is the last one.
+ */
+typedef struct AdaptTree
+{
+    ADAPTNODE node[ADAPTNODES]; /**< Nodes, in sibling property order */
+    int leaf[MAXSYMBOLS];       /**< Node of every symbol, -1 if not seen yet */
+    int nyt;                    /**< Index of the NYT node */
+} ADAPTTREE;
+
+/**
+ * @brief Initializes an FGK tree that only holds the NYT node.
+ *
+ * @param t Tree.
+ * @return void
+ */
+void initAdapt(ADAPTTREE *);
+
+/**
+ * @brief Writes the code of a symbol and updates the tree.
+ *
+ * @param t Tree.
+ * @param bw Bit writer.
+ * @param symbol Byte value or EOS.
+ * @return void
+ */
+void encodeAdapt(ADAPTTREE *, BITWRITER *, int);
+
+/**
+ * @brief Reads the code of a symbol and updates the tree.
+ *
+ * @param t Tree.
+ * @param br Bit reader.
+ * @return The byte value or EOS, -1 if the input ended in a code.
+ */
+int decodeAdapt(ADAPTTREE *, BITREADER *);
+
+/**
+ * @brief Compresses a stream with adaptive codes in a single pass.
+ *
+ * Input is coded as soon as it is read, and the complete words of output
+ * are written out after every read, so a live stream is delayed by at most
+ * one read.
+ *
+ * @param in Input file, for example stdin.
+ * @param out Output file, for example stdout.
+ * @param interval Bytes between two rebuilds, 0 for FGK adaptive Huffman.
+ * @return void
+ */
+void adaptiveCompress(FILE *, FILE *, int);
+
+/**
+ * @brief Decompresses an adaptive stream.
+ *
+ * Input is read with read(), so a pipe is decoded as soon as bytes arrive
+ * instead of after a full buffer, and the output is written after every
+ * read. A code cut off by the end of a read is decoded with the next one.
+ *
+ * @param in Input file, for example stdin.
+ * @param out Output file, for example stdout.
+ * @return void
+ */
+void adaptiveDecompress(FILE *, FILE *);
+
+#endif
@@ -11,45 +11,216 @@ void allocateMem(char **filename, char *optarg)
     }
 }
 
+// Opens a file, "-" stands for the given standard stream
+static FILE *openStd(char *name, FILE *std, const char *mode, const char *error)
+{
+    FILE *fp = strcmp(name, "-") == 0 ? std : fopen(name, mode);
+    if (fp == NULL)
+    {
+        perror(error);
+        exit(EXIT_FAILURE);
+    }
+    return fp;
+}
+
+static void closeStd(FILE *fp1, FILE *fp2)
+{
+    if (fp1 != stdin)
+        fclose(fp1);
+    if (fp2 != stdout && fclose(fp2) != 0)
+    {
+        perror("Error writing output file");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void streamFiles(char *input, char *output, int decode)
+{
+    FILE *fp1 = openStd(input, stdin, "rb", "Error opening input file");
+    FILE *fp2 = openStd(output, stdout, "wb", "Error opening output file");
+    double timer = STATBEGIN();
+    if (decode)
+        decompressStream(fp1, fp2);
+    else
+        compressStream(fp1, fp2);
+    closeStd(fp1, fp2);
+    STATEND(decode ? STATDECODE : STATENCODE, timer, statFileSize(decode ? output : input));
+}
+
+void adaptiveFiles(char *input, char *output, int decode, int interval)
+{
+    FILE *fp1 = openStd(input, stdin, "rb", "Error opening input file");
+    FILE *fp2 = openStd(output, stdout, "wb", "Error opening output file");
+    double timer = STATBEGIN();
+    if (decode)
+        adaptiveDecompress(fp1, fp2);
+    else
+        adaptiveCompress(fp1, fp2, interval);
+    closeStd(fp1, fp2);
+    STATEND(decode ? STATDECODE : STATENCODE, timer, statFileSize(decode ? output : input));
+}
+
+// Parses a comma separated list of transforms, returns their block flags or -1
+static int parseTransforms(const char *list)
+{
+    static const char *names[] = {"bwt", "mtf", "rle"};
+    static const int flags[] = {BLOCKBWT, BLOCKMTF, BLOCKRLE};
+    int transforms = 0;
+    while (*list != '\0')
+    {
+        size_t n = strcspn(list, ",");
+        int found = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            if (n == strlen(names[i]) && strncmp(list, names[i], n) == 0)
+            {
+                transforms |= flags[i];
+                found = 1;
+            }
+        }
+        if (!found)
+            return -1;
+        list += n;
+        if (*list == ',')
+            list++;
+    }
+    return transforms == 0 ? -1 : transforms;
+}
+
 void readArg(int argumentc, char **argumentv)
 {
     char *filename = NULL;
     char *filenameOut = NULL;
     char *prob = NULL;
     int c;
+    int text = 0;
+    int eos = 0;
+    int threads = -1;
+    int global = 0;
+    int split = 0;
+    int transforms = 0;
+    int maxLen = 0;
+    int interval = 0;
+    int order1 = 0;
+    uint32_t index = 0;
+    int range = 0;
+    int samples = 0;
+    unsigned long long from = 0;
+    unsigned long long to = 0;
+    double timer;
+    static struct option longOptions[] = {{"stats", optional_argument, NULL, 'S'}, {NULL, 0, NULL, 0}};
     opterr = 0;
     if (argumentc == 1)
     {
         printf("No command line arguments given!\n");
         exit(EXIT_FAILURE);
     }
-    float *f = (float *)malloc(128 * sizeof(float));
+    float *f = (float *)malloc(MAXSYMBOLS * sizeof(float));
     if (f == NULL)
     {
         perror("Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
-    for (int i = 0; i < 128; i++)
+    for (int i = 0; i < MAXSYMBOLS; i++)
         f[i] = 0.0;
-    char **codes = (char **)malloc(129 * sizeof(char *));
+    char **codes = (char **)malloc((MAXSYMBOLS + 1) * sizeof(char *));
     if (codes == NULL)
     {
         perror("Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
-    for (int i = 0; i < 128; i++)
+    for (int i = 0; i < MAXSYMBOLS; i++)
         codes[i] = NULL;
-    int count = 0;
-    TREENODE **t = (TREENODE **)malloc(128 * sizeof(TREENODE *));
-    if (t == NULL)
-    {
-        perror("Memory allocation failed");
-        exit(EXIT_FAILURE);
-    }
-    while ((c = getopt(argumentc, argumentv, "p:s:e:d:")) != -1)
+    int len[MAXSYMBOLS];
+    HUFFTREE t = {NULL, 0, -1, 0, NULL};
+    while ((c = getopt_long(argumentc, argumentv, "tzgoij:l:k:b:r:n:f:p:s:e:d:c:x:m:a:u:", longOptions, NULL)) != -1)
     {
         switch (c)
         {
+        case 't':
+            text = 1;
+            break;
+        case 'z':
+            eos = 1;
+            break;
+        case 'g':
+            global = 1;
+            break;
+        case 'o':
+            order1 = 1;
+            break;
+        case 'S':
+            if (optarg != NULL && strcmp(optarg, "json") != 0 && strcmp(optarg, "text") != 0)
+            {
+                printf("Error: --stats takes 'text' or 'json'\n");
+                exit(EXIT_FAILURE);
+            }
+            statsMode = optarg != NULL && strcmp(optarg, "json") == 0 ? STATSJSON : STATSTEXT;
+            break;
+        case 'i':
+            split = 1;
+            if (threads < 0)
+                threads = 0;
+            break;
+        case 'f':
+            transforms = parseTransforms(optarg);
+            if (transforms == -1)
+            {
+                printf("Error: -f needs a list of transforms from bwt, mtf and rle\n");
+                exit(EXIT_FAILURE);
+            }
+            if (threads < 0)
+                threads = 0;
+            break;
+        case 'j':
+            if (!isdigit((unsigned char)optarg[0]))
+            {
+                printf("Error: -j needs a number of threads\n");
+                exit(EXIT_FAILURE);
+            }
+            threads = atoi(optarg);
+            break;
+        case 'l':
+            maxLen = atoi(optarg);
+            if (!isdigit((unsigned char)optarg[0]) || maxLen > MAXCODELEN)
+            {
+                printf("Error: -l needs a code length from 0 to %d\n", MAXCODELEN);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'k':
+            interval = atoi(optarg);
+            if (!isdigit((unsigned char)optarg[0]) || interval > ADAPTMAXKIB)
+            {
+                printf("Error: -k needs a number of KiB from 0 to %d\n", ADAPTMAXKIB);
+                exit(EXIT_FAILURE);
+            }
+            interval *= 1024;
+            break;
+        case 'b':
+            if (!isdigit((unsigned char)optarg[0]) || atoi(optarg) < 1 || atoi(optarg) > INDEXMAXKIB)
+            {
+                printf("Error: -b needs a number of KiB from 1 to %d\n", INDEXMAXKIB);
+                exit(EXIT_FAILURE);
+            }
+            index = (uint32_t)atoi(optarg) * 1024;
+            break;
+        case 'r':
+            if (sscanf(optarg, "%llu:%llu", &from, &to) != 2 || from > to)
+            {
+                printf("Error: -r needs a range of characters FROM:TO\n");
+                exit(EXIT_FAILURE);
+            }
+            range = 1;
+            break;
+        case 'n':
+            samples = atoi(optarg);
+            if (!isdigit((unsigned char)optarg[0]) || samples < 0)
+            {
+                printf("Error: -n needs a number of blocks\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 'p':
             allocateMem(&filename, optarg);
             allocateMem(&filenameOut, optarg);
@@ -81,7 +252,84 @@ void readArg(int argumentc, char **argumentv)
                 free(filenameOut);
                 exit(EXIT_FAILURE);
             }
+            timer = STATBEGIN();
             probFile(filename, filenameOut, f);
+            STATEND(STATHISTOGRAM, timer, statFileSize(filename));
+            free(filename);
+            free(filenameOut);
+            break;
+        case 'c':
+        case 'x':
+            allocateMem(&filename, optarg);
+            strcpy(filename, optarg);
+            if (optind < argumentc)
+            {
+                allocateMem(&filenameOut, argumentv[optind]);
+                strcpy(filenameOut, argumentv[optind++]);
+            }
+            else
+            {
+                printf("Error: Missing output file after -%c\n", c);
+                free(filename);
+                exit(EXIT_FAILURE);
+            }
+            // Check if the compressed file name ends with ".enc", "-" is stdin/stdout
+            if ((c == 'c' && strstr(filenameOut, ".enc") == NULL && strcmp(filenameOut, "-") != 0) ||
+                (c == 'x' && strstr(filename, ".enc") == NULL && strcmp(filename, "-") != 0))
+            {
+                printf("Error: Compressed file names must end with '.enc'\n");
+                free(filename);
+                free(filenameOut);
+                exit(EXIT_FAILURE);
+            }
+            if (strcmp(filename, "-") == 0 || strcmp(filenameOut, "-") == 0 || (c == 'x' && fileMagic(filename, STREAMMAGIC)))
+                streamFiles(filename, filenameOut, c == 'x');
+            else if (c == 'c' && order1)
+                compressContext(filename, filenameOut, maxLen);
+            else if (c == 'c' && threads >= 0)
+                compressBlocks(filename, filenameOut, threads, global, split, maxLen, transforms);
+            else if (c == 'c')
+                compressFile(filename, filenameOut, eos, maxLen, index, samples);
+            else if (range && fileMagic(filename, PACKEDMAGIC))
+                decompPackedRange(filename, filenameOut, from, to);
+            else if (range)
+            {
+                printf("Error: -r needs a packed file\n");
+                exit(EXIT_FAILURE);
+            }
+            else if (fileMagic(filename, CONTEXTMAGIC))
+                decompContext(filename, filenameOut);
+            else if (fileMagic(filename, BLOCKMAGIC))
+                decompBlocks(filename, filenameOut, threads < 0 ? 0 : threads);
+            else
+                decompPackedFile(filename, filenameOut, NULL, NULL);
+            if (c == 'c')
+                statCoding(filename, filenameOut, 0);
+            else if (!range)
+                statCoding(filenameOut, filename, 0);
+            free(filename);
+            free(filenameOut);
+            break;
+        case 'a':
+        case 'u':
+            allocateMem(&filename, optarg);
+            strcpy(filename, optarg);
+            if (optind < argumentc)
+            {
+                allocateMem(&filenameOut, argumentv[optind]);
+                strcpy(filenameOut, argumentv[optind++]);
+            }
+            else
+            {
+                printf("Error: Missing output file after -%c\n", c);
+                free(filename);
+                exit(EXIT_FAILURE);
+            }
+            adaptiveFiles(filename, filenameOut, c == 'u', interval);
+            if (c == 'a')
+                statCoding(filename, filenameOut, 0);
+            else
+                statCoding(filenameOut, filename, 0);
             free(filename);
             free(filenameOut);
             break;
@@ -101,10 +349,37 @@ void readArg(int argumentc, char **argumentv)
                 free(filename);
                 exit(EXIT_FAILURE);
             }
+            timer = STATBEGIN();
             readProb(filename, f);
-            count = huffmanT(f, codes, t);
+            STATEND(STATPARSE, timer, statFileSize(filename));
+            huffmanT(f, codes, len, &t, maxLen);
             free(filename);
             break;
+        case 'm':
+            allocateMem(&filename, optarg);
+            strcpy(filename, optarg);
+            if (optind < argumentc)
+            {
+                allocateMem(&filenameOut, argumentv[optind]);
+                strcpy(filenameOut, argumentv[optind++]);
+            }
+            else
+            {
+                printf("Error: Missing output file after -%c\n", c);
+                free(filename);
+                exit(EXIT_FAILURE);
+            }
+            if (strstr(filename, ".txt") == NULL)
+            {
+                printf("Error: File names must end with '.txt'\n");
+                free(filename);
+                free(filenameOut);
+                exit(EXIT_FAILURE);
+            }
+            saveModel(cachedModel(filename, eos, maxLen), filenameOut);
+            free(filename);
+            free(filenameOut);
+            break;
         case 'e':
         case 'd':
             allocateMem(&prob, optarg);
@@ -144,10 +419,11 @@ void readArg(int argumentc, char **argumentv)
                 free(filenameOut);
                 exit(EXIT_FAILURE);
             }
-            // Check if file names end with ".txt"
+            // Check if file names end with ".txt", a model file can have any name
+            int model = fileMagic(prob, MODELMAGIC);
             if (c == 'e')
             {
-                if (strstr(filename, ".txt") == NULL || strstr(filenameOut, ".txt.enc") == NULL || strstr(prob, ".txt") == NULL)
+                if (strstr(filename, ".txt") == NULL || strstr(filenameOut, ".txt.enc") == NULL || (!model && strstr(prob, ".txt") == NULL))
                 {
                     printf("Error: File names must end with '.txt' and output file with '.enc'\n");
                     free(prob);
@@ -158,7 +434,7 @@ void readArg(int argumentc, char **argumentv)
             }
             else if (c == 'd')
             {
-                if (strstr(filename, ".txt.enc") == NULL || strstr(filenameOut, ".txt.new") == NULL || strstr(prob, ".txt") == NULL)
+                if (strstr(filename, ".txt.enc") == NULL || strstr(filenameOut, ".txt.new") == NULL || (!model && strstr(prob, ".txt") == NULL))
                 {
                     printf("Error: File names must end with '.txt', input file with '.enc' and output file with '.new'\n");
                     free(prob);
@@ -167,25 +443,52 @@ void readArg(int argumentc, char **argumentv)
                     exit(EXIT_FAILURE);
                 }
             }
-            readProb(prob, f);
-            count = huffmanT(f, codes, t);
-            if (c == 'e')
+            CODEMODEL *m = NULL;
+            if (model)
+            {
+                // A compiled model needs no parsing, tree or printing
+                timer = STATBEGIN();
+                m = cachedModel(prob, eos, maxLen);
+                STATEND(STATPARSE, timer, statFileSize(prob));
+                memcpy(len, m->len, sizeof(len));
+                codeStrings(len, m->bits, codes, MAXSYMBOLS, &t);
+            }
+            else
+            {
+                timer = STATBEGIN();
+                readProb(prob, f);
+                STATEND(STATPARSE, timer, statFileSize(prob));
+                if (eos)
+                    addEOS(f);
+                huffmanT(f, codes, len, &t, maxLen);
+            }
+            timer = STATBEGIN();
+            if (c == 'e' && text)
+            {
                 printEncFile(codes, filename, filenameOut);
+                STATEND(STATENCODE, timer, statFileSize(filename));
+            }
+            else if (c == 'e')
+                encPackedFile(len, m, filename, filenameOut, index);
+            else if (text)
+            {
+                decompFile(filename, filenameOut, len);
+                STATEND(STATDECODE, timer, statFileSize(filenameOut));
+            }
+            else
+                decompPackedFile(filename, filenameOut, len, m);
+            if (c == 'e')
+                statCoding(filename, filenameOut, text);
             else
-                decompFile(filename, filenameOut, t, count);
+                statCoding(filenameOut, filename, text);
             free(prob);
             free(filename);
             free(filenameOut);
             break;
         case '?':
-            if (optopt == 'p')
-                printf("Option requires an argument -- 'p'\n");
-            if (optopt == 's')
-                printf("Option requires an argument -- 's'\n");
-            if (optopt == 'e')
-                printf("Option requires an argument -- 'e'\n");
-            if (optopt == 'd')
-                printf("Option requires an argument -- 'd'\n");
+            // The options that take an argument, as in the getopt string
+            if (optopt != 0 && strchr("psedcxmaukbrnfjl", optopt) != NULL)
+                printf("Option requires an argument -- '%c'\n", optopt);
             else if (isprint(optopt))
                 fprintf(stderr, "Invalid option -- '%c'\n", optopt);
             else
@@ -194,24 +497,12 @@ void readArg(int argumentc, char **argumentv)
             break;
         }
     }
-    // Free other dynamically allocated arrays
-    for (int i = 0; i < 128; i++)
-    {
-        if (codes[i] != NULL)
-        {
-            free(codes[i]);
-        }
-    }
+    statsReport();
+    // The code strings belong to the tree
     free(codes);
-    for (int i = 0; i < 128; i++)
-    {
-        if (t[i] != NULL)
-        {
-            freeTree(t[i]);
-        }
-    }
+    freeModelCache();
+    freeTree(&t);
     free(f);
-    free(t);
 }
 
 #ifdef DEBUG3
@@ -12,6 +12,52 @@
  * - `-e`: Encode a file using a pre-built Huffman tree and save the result to another file.
  * - `-d`: Decode a Huffman-encoded file using a pre-built Huffman tree and save
  *         the result to another file.
+ * - `-c`: Compress a file in one go: count its bytes, build the codes and
+ *         write a self-describing packed file, without a probability file.
+ * - `-x`: Decompress a packed file using only the code lengths in its header.
+ * - `-j`: Make the `-c` options that follow it write the block format with
+ *         the given number of threads (0 for one per CPU). `-x` always
+ *         decodes block files in parallel, with this many threads if given.
+ * - `-g`: Code all blocks of `-j` with one global code table instead of a
+ *         table per block.
+ * - `-i`: Split every block of `-j` into 4 streams that are decoded in
+ *         parallel by a single thread. Implies `-j 0` if `-j` isn't given.
+ * - `-f`: Apply the comma separated transforms bwt, mtf and rle (see
+ *         transform.h) to every block of `-j` before coding it. Implies
+ *         `-j 0` if `-j` isn't given.
+ * - `-o`: Make the `-c` options that follow it write the context format
+ *         (see context.h), which codes every byte with a table picked by the
+ *         byte before it. `-x` detects context files.
+ * - `-l`: Limit the codes of the options that follow it to the given number
+ *         of bits (0 for no limit) and print what that costs in size.
+ * - `-m`: Compile a probability file into a model file (see model.h), which
+ *         `-e` and `-d` take in place of the probability file to skip
+ *         parsing it and building the tree. `-z` and `-l` before `-m` are
+ *         compiled into the model.
+ * - `-a`: Compress a file or stream with adaptive Huffman codes in a single
+ *         pass (see adaptive.h), without a probability file.
+ * - `-u`: Decompress a file or stream written by `-a`.
+ * - `-k`: Make the `-a` options that follow it rebuild canonical codes every
+ *         given number of KiB instead of updating an FGK tree after every
+ *         byte (0 for FGK).
+ * - `--stats`: Time every stage of the options that follow it and print the
+ *         times, byte counts, entropy, achieved bits per symbol and peak
+ *         memory to stderr at the end (see stats.h). `--stats=json` prints
+ *         them as JSON.
+ * - `-b`: Make the packed files of the `-e` and `-c` options that follow it
+ *         end with an index of bit offsets, one every given number of KiB.
+ * - `-r`: Make the `-x` options that follow it decode only the characters
+ *         FROM:TO, from FROM up to but not including TO, of a packed file.
+ *         With an index only the part after the last entry before FROM is
+ *         decoded.
+ * - `-n`: Make the `-c` options that follow it estimate the byte counts from
+ *         the given number of evenly spaced 64 KiB blocks instead of reading
+ *         the whole input twice (0 to count everything), and print the
+ *         estimated against the actual bits per byte.
+ * - `-t`: Use the textual '0'/'1' format for the `-e` and `-d` options that
+ *         follow it instead of the packed binary format.
+ * - `-z`: Add an end-of-stream symbol to the codes of the `-e`, `-d` and `-c`
+ *         options that follow it, so the packed stream terminates itself.
  *
  * The program dynamically allocates memory for file names, probabilities, and
  * other data structures. It checks for memory allocation errors and ensures
@@ -20,9 +66,21 @@
  * and processing functionality.
  *
  * @note This program assumes that the provided input and output file names end
- * with ".txt", ".txt.enc", or ".txt.new" based on the operation being performed.
+ * with ".txt", ".txt.enc", or ".txt.new" based on the operation being performed,
+ * except for `-c` and `-x`, which only need the compressed file to end with ".enc".
+ * With `-c` and `-x`, "-" stands for stdin or stdout and selects the stream
+ * format (see stream.h), which is also what `-x` uses for "HUFS" files.
+ * `-a` and `-u` take any file names, and "-" for stdin or stdout.
  * 
  * @see huffmanTree.h
+ * @see packed.h
+ * @see block.h
+ * @see stream.h
+ * @see context.h
+ * @see model.h
+ * @see probability.h
+ * @see adaptive.h
+ * @see stats.h
  * @see file.h
  *
  * @author Elena Eleftheriou
@@ -32,11 +90,22 @@
 #include <string.h>
 #include <ctype.h>
 #include "huffmanTree.h"
+#include "packed.h"
+#include "block.h"
+#include "stream.h"
+#include "context.h"
+#include "model.h"
+#include "probability.h"
+#include "adaptive.h"
+#include "stats.h"
 #include "file.h"
 
 #ifndef ARGUMENTH
 #define ARGUMENTH
 
+/** Longest index interval in KiB that can be given with `-b`. */
+#define INDEXMAXKIB (1 << 20)
+
 /**
  * @brief Allocates memory for a string and assigns the value of optarg to it.
  *
@@ -49,11 +118,36 @@
  */
 void allocateMem(char **, char *);
 
+/**
+ * @brief Compresses or decompresses a stream between files, stdin and stdout.
+ *
+ * A file name of "-" stands for stdin (input) or stdout (output).
+ *
+ * @param input Input file name or "-".
+ * @param output Output file name or "-".
+ * @param decode 1 to decompress, 0 to compress.
+ * @return void
+ */
+void streamFiles(char *, char *, int);
+
+/**
+ * @brief Compresses or decompresses an adaptive stream between files, stdin and stdout.
+ *
+ * A file name of "-" stands for stdin (input) or stdout (output).
+ *
+ * @param input Input file name or "-".
+ * @param output Output file name or "-".
+ * @param decode 1 to decompress, 0 to compress.
+ * @param interval Bytes between two rebuilds of the codes, 0 for FGK.
+ * @return void
+ */
+void adaptiveFiles(char *, char *, int, int);
+
 /**
  * @brief Processes command line arguments and performs corresponding actions.
  *
  * This function processes the command line arguments using getopt.
- * It performs actions based on the specified options ('p', 's', 'e', 'd').
+ * It performs actions based on the specified options ('t', 'z', 'g', 'o', 'i', 'j', 'l', 'k', 'b', 'r', 'n', 'p', 's', 'e', 'd', 'c', 'x', 'm', 'a', 'u', "stats").
  * Handles memory allocation, file name validation, and other checks.
  *
  * @param argumentc Number of command line arguments.
@@ -0,0 +1,74 @@
+#include "batch.h"
+
+int encodeBatch(CODEMODEL *m, const unsigned char **records, const size_t *sizes, size_t n, BATCHARENA *arena)
+{
+    if (n > arena->capacity)
+    {
+        free(arena->entry);
+        arena->entry = (BATCHENTRY *)malloc(n * sizeof(BATCHENTRY));
+        if (arena->entry == NULL)
+        {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        arena->capacity = n;
+    }
+    BITWRITER bw;
+    openBufferWriter(&bw);
+    int missing = 0;
+    // The records follow each other without padding, so there is nothing
+    // to set up between them
+    for (size_t i = 0; i < n; i++)
+    {
+        BATCHENTRY *e = &arena->entry[i];
+        e->offset = bw.bits;
+        missing |= writeSymbols(&bw, records[i], sizes[i], m->table, m->longest);
+        e->bits = (uint32_t)(bw.bits - e->offset);
+        e->size = (uint32_t)sizes[i];
+    }
+    closeWriter(&bw);
+    free(arena->data);
+    arena->data = bw.buf;
+    arena->size = bw.pos;
+    arena->count = n;
+    return missing ? -1 : 0;
+}
+
+int decodeBatch(CODEMODEL *m, BATCHARENA *arena, unsigned char **out)
+{
+    BITREADER br;
+    openBufferReader(&br, arena->data, arena->size);
+    int result = 0;
+    for (size_t i = 0; i < arena->count && result == 0; i++)
+        result = decodeStreams(&m->dt, &br, 1, out[i], arena->entry[i].size);
+    closeReader(&br);
+    return result;
+}
+
+int decodeRecord(CODEMODEL *m, BATCHARENA *arena, size_t i, unsigned char *out)
+{
+    if (i >= arena->count || arena->entry[i].offset / 8 > arena->size)
+        return -1;
+    BATCHENTRY *e = &arena->entry[i];
+    BITREADER br;
+    openBufferReader(&br, arena->data + e->offset / 8, arena->size - e->offset / 8);
+    uint64_t unused;
+    int result = 0;
+    if (e->offset % 8 != 0)
+        result = readBits(&br, (int)(e->offset % 8), &unused);
+    if (result == 0)
+        result = decodeStreams(&m->dt, &br, 1, out, e->size);
+    closeReader(&br);
+    return result;
+}
+
+void freeBatch(BATCHARENA *arena)
+{
+    free(arena->data);
+    free(arena->entry);
+    arena->data = NULL;
+    arena->entry = NULL;
+    arena->size = 0;
+    arena->count = 0;
+    arena->capacity = 0;
+}
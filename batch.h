@@ -0,0 +1,95 @@
+/**
+ * @file batch.h
+ * @brief Encoding and decoding many small records against one model.
+ *
+ * Coding records of a few hundred bytes one call at a time spends most of
+ * the time on setting up writers, readers and tables. The batch API codes
+ * a whole array of records with one code model (see model.h) in one call:
+ * the records are written back to back into a single bitstream, the arena,
+ * and every record gets an entry with its bit offset, its length in bits
+ * and its length in bytes. Decoding runs over the arena in one pass into
+ * buffers the caller provides, and a single record can be decoded on its
+ * own from its offset.
+ *
+ * The records don't use the end-of-stream symbol, their lengths are in the
+ * entries.
+ *
+ * @see model.h
+ * @see bitio.h
+ */
+
+#include "model.h"
+
+#ifndef BATCHH
+#define BATCHH
+
+/**
+ * @struct BATCHENTRY
+ * @brief Where a record is in the arena.
+ */
+typedef struct BatchEntry
+{
+    uint64_t offset; /**< Bit offset of the record in the arena */
+    uint32_t bits;   /**< Length of the coded record in bits */
+    uint32_t size;   /**< Length of the record in bytes */
+} BATCHENTRY;
+
+/**
+ * @struct BATCHARENA
+ * @brief Coded records and their entries.
+ *
+ * Initialize it with {NULL, 0, NULL, 0, 0}. Encoding into an arena again
+ * reuses its entries, and freeBatch releases everything.
+ */
+typedef struct BatchArena
+{
+    unsigned char *data; /**< Bitstream of all records, padded to 64-bit words */
+    size_t size;         /**< Number of bytes in data */
+    BATCHENTRY *entry;   /**< Entry of every record */
+    size_t count;        /**< Number of records */
+    size_t capacity;     /**< Number of entries allocated */
+} BATCHARENA;
+
+/**
+ * @brief Encodes an array of records into an arena.
+ *
+ * @param m Code model.
+ * @param records Array of n records.
+ * @param sizes Length in bytes of every record, each below 2^32 / 64.
+ * @param n Number of records.
+ * @param arena Arena to store the coded records in, replacing its contents.
+ * @return 0 on success, -1 if a record has a byte without a code.
+ */
+int encodeBatch(CODEMODEL *, const unsigned char **, const size_t *, size_t, BATCHARENA *);
+
+/**
+ * @brief Decodes every record of an arena.
+ *
+ * @param m Code model the arena was encoded with.
+ * @param arena Arena.
+ * @param out Array of arena->count buffers, each at least as long as the
+ *            size in the entry of its record.
+ * @return 0 on success, -1 if the arena is corrupted.
+ */
+int decodeBatch(CODEMODEL *, BATCHARENA *, unsigned char **);
+
+/**
+ * @brief Decodes one record of an arena.
+ *
+ * @param m Code model the arena was encoded with.
+ * @param arena Arena.
+ * @param i Index of the record.
+ * @param out Buffer at least as long as the size in the entry of the record.
+ * @return 0 on success, -1 if the arena is corrupted.
+ */
+int decodeRecord(CODEMODEL *, BATCHARENA *, size_t, unsigned char *);
+
+/**
+ * @brief Frees the memory of an arena.
+ *
+ * @param arena Arena.
+ * @return void
+ */
+void freeBatch(BATCHARENA *);
+
+#endif
@@ -0,0 +1,318 @@
+/**
+ * @file bench.c
+ * @brief Throughput benchmarks of the Huffman coding stages.
+ *
+ * Generates corpora of several kinds and sizes and times every stage of
+ * coding them on its own: counting the bytes (histogram), building the tree
+ * (tree), finding the canonical codes (codes), encoding into memory (encode)
+ * and decoding back (decode, including building the lookup table), and
+ * coding the corpus as BENCHRECORD byte records with the batch API
+ * (batch_encode, batch_decode). The corpora are:
+ *
+ * - uniform: 64 byte values, all equally likely,
+ * - skewed: byte value k with probability 2^-(k+1),
+ * - english: English words with Zipf-like frequencies, in sentences,
+ * - binary: all 256 byte values, all equally likely.
+ *
+ * Every stage runs at least BENCHRUNS times and until BENCHTIME seconds
+ * passed, and the fastest run is reported. The results are printed as CSV
+ * with the columns corpus, bytes, stage, runs, seconds, mb_per_s,
+ * ns_per_symbol and ratio (compressed size over input size), so they can be
+ * compared between releases. Rates are per input byte for every stage.
+ *
+ * Build and run with `make bench`. The corpus sizes in KiB can be given as
+ * arguments, the default is BENCHSIZES.
+ *
+ * @see histogram.h
+ * @see canonical.h
+ * @see lookup.h
+ * @see batch.h
+ */
+
+// clock_gettime is POSIX, not C99
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+#include "histogram.h"
+#include "lookup.h"
+#include "batch.h"
+
+/** Minimum number of runs of every stage. */
+#define BENCHRUNS 3
+
+/** Minimum time in seconds spent on every stage. */
+#define BENCHTIME 0.25
+
+/** Default corpus sizes in KiB. */
+#define BENCHSIZES {64, 1024, 16384}
+
+/** Size in bytes of the records coded with the batch API. */
+#define BENCHRECORD 1000
+
+/** Number of different corpora. */
+#define BENCHCORPORA 4
+
+static const char *corpusNames[BENCHCORPORA] = {"uniform", "skewed", "english", "binary"};
+
+static const char *words[] = {
+    "the", "of", "and", "to", "a", "in", "is", "it", "you", "that", "he", "was", "for", "on", "are",
+    "with", "as", "his", "they", "be", "at", "one", "have", "this", "from", "or", "had", "by", "hot",
+    "word", "but", "what", "some", "we", "can", "out", "other", "were", "all", "there", "when", "up",
+    "use", "your", "how", "said", "an", "each", "she", "which", "do", "their", "time", "if", "will",
+    "way", "about", "many", "then", "them", "write", "would", "like", "so", "these", "her", "long",
+    "make", "thing", "see", "him", "two", "has", "look", "more", "day", "could", "go", "come", "did",
+    "number", "sound", "no", "most", "people", "my", "over", "know", "water", "than", "call", "first",
+    "who", "may", "down", "side", "been", "now", "find", "compression", "huffman", "stream"};
+
+static uint64_t state = 0x9e3779b97f4a7c15ULL;
+
+// xorshift64*, so the corpora are the same on every run
+static uint64_t nextRandom(void)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545f4914f6cdd1dULL;
+}
+
+static void makeCorpus(int kind, unsigned char *buf, size_t n)
+{
+    size_t nwords = sizeof(words) / sizeof(words[0]);
+    size_t i = 0;
+    int sentence = 0;
+    while (i < n)
+    {
+        uint64_t r = nextRandom();
+        if (kind == 0)
+            buf[i++] = (unsigned char)('0' + (r & 63));
+        else if (kind == 1)
+        {
+            int k = 0;
+            while (k < SYMBOLS - 1 && (r & 1))
+            {
+                k++;
+                r >>= 1;
+                if (k % 63 == 0)
+                    r = nextRandom();
+            }
+            buf[i++] = (unsigned char)k;
+        }
+        else if (kind == 3)
+            buf[i++] = (unsigned char)r;
+        else
+        {
+            // Zipf-like: the minimum of two uniform picks favours early words
+            size_t a = (r & 0xffffffff) % nwords;
+            size_t b = (r >> 32) % nwords;
+            const char *w = words[a < b ? a : b];
+            for (size_t j = 0; w[j] != '\0' && i < n; j++)
+                buf[i++] = (unsigned char)(j == 0 && sentence == 0 ? w[j] - 'a' + 'A' : w[j]);
+            sentence++;
+            if (i < n && sentence > 6 + (int)(r % 11))
+            {
+                buf[i++] = '.';
+                sentence = 0;
+            }
+            if (i < n)
+                buf[i++] = (r >> 40) % 13 == 0 ? '\n' : ' ';
+        }
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Everything the stages hand to each other
+typedef struct BenchState
+{
+    const unsigned char *data;
+    size_t n;
+    uint64_t counts[MAXSYMBOLS];
+    HUFFTREE ht;
+    int len[MAXSYMBOLS];
+    uint64_t bits[MAXSYMBOLS];
+    CODEENTRY table[MAXSYMBOLS];
+    int longest;
+    unsigned char *enc;
+    size_t encSize;
+    unsigned char *out;
+    CODEMODEL model;
+    BATCHARENA arena;
+    const unsigned char **records;
+    unsigned char **recordsOut;
+    size_t *sizes;
+    size_t nrecords;
+} BENCHSTATE;
+
+static void stageHistogram(BENCHSTATE *s)
+{
+    for (int i = 0; i < MAXSYMBOLS; i++)
+        s->counts[i] = 0;
+    countBuffer(s->data, s->n, s->counts);
+}
+
+static void stageTree(BENCHSTATE *s)
+{
+    buildTree(s->counts, &s->ht, MAXSYMBOLS);
+}
+
+static void stageCodes(BENCHSTATE *s)
+{
+    codeLengths(&s->ht, s->len);
+    canonicalCodes(s->len, s->bits, MAXSYMBOLS);
+    s->longest = encodeTable(s->table, s->len, s->bits, SYMBOLS);
+}
+
+static void stageEncode(BENCHSTATE *s)
+{
+    BITWRITER bw;
+    openBufferWriter(&bw);
+    writeSymbols(&bw, s->data, s->n, s->table, s->longest);
+    closeWriter(&bw);
+    free(s->enc);
+    s->enc = bw.buf;
+    s->encSize = bw.pos;
+}
+
+static void stageDecode(BENCHSTATE *s)
+{
+    DECODETABLE dt;
+    tableFromLengths(&dt, s->len, MAXSYMBOLS);
+    BITREADER br;
+    openBufferReader(&br, s->enc, s->encSize);
+    if (decodeStreams(&dt, &br, 1, s->out, s->n) == -1)
+    {
+        printf("Error: Decoding failed\n");
+        exit(EXIT_FAILURE);
+    }
+    closeReader(&br);
+    freeTable(&dt);
+}
+
+static void stageBatchEncode(BENCHSTATE *s)
+{
+    encodeBatch(&s->model, s->records, s->sizes, s->nrecords, &s->arena);
+}
+
+static void stageBatchDecode(BENCHSTATE *s)
+{
+    if (decodeBatch(&s->model, &s->arena, s->recordsOut) == -1)
+    {
+        printf("Error: Batch decoding failed\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Runs a stage until it was timed often and long enough and prints its fastest run
+static void timeStage(BENCHSTATE *s, int kind, const char *stage, void (*run)(BENCHSTATE *))
+{
+    double best = 0;
+    double spent = 0;
+    int runs = 0;
+    while (runs < BENCHRUNS || spent < BENCHTIME)
+    {
+        double start = now();
+        run(s);
+        double t = now() - start;
+        if (runs == 0 || t < best)
+            best = t;
+        spent += t;
+        runs++;
+    }
+    double ratio = (double)s->encSize / (double)s->n;
+    printf("%s,%llu,%s,%d,%.9f,%.2f,%.3f,%.4f\n", corpusNames[kind], (unsigned long long)s->n, stage, runs, best,
+           best > 0 ? (double)s->n / best / 1e6 : 0, best * 1e9 / (double)s->n, ratio);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t defaults[] = BENCHSIZES;
+    int nsizes = argc > 1 ? argc - 1 : (int)(sizeof(defaults) / sizeof(defaults[0]));
+    printf("corpus,bytes,stage,runs,seconds,mb_per_s,ns_per_symbol,ratio\n");
+    for (int kind = 0; kind < BENCHCORPORA; kind++)
+    {
+        for (int j = 0; j < nsizes; j++)
+        {
+            size_t n = (argc > 1 ? (size_t)atol(argv[j + 1]) : defaults[j]) * 1024;
+            if (n == 0)
+            {
+                printf("Error: Corpus sizes must be at least 1 KiB\n");
+                exit(EXIT_FAILURE);
+            }
+            BENCHSTATE *s = (BENCHSTATE *)calloc(1, sizeof(BENCHSTATE));
+            unsigned char *data = (unsigned char *)malloc(n);
+            if (s == NULL || data == NULL)
+            {
+                perror("Memory allocation failed");
+                exit(EXIT_FAILURE);
+            }
+            makeCorpus(kind, data, n);
+            s->data = data;
+            s->n = n;
+            s->ht.root = -1;
+            s->out = (unsigned char *)malloc(n);
+            if (s->out == NULL)
+            {
+                perror("Memory allocation failed");
+                exit(EXIT_FAILURE);
+            }
+            // The ratio is known once the first encode ran, so it runs once up front
+            stageHistogram(s);
+            stageTree(s);
+            stageCodes(s);
+            stageEncode(s);
+            timeStage(s, kind, "histogram", stageHistogram);
+            timeStage(s, kind, "tree", stageTree);
+            timeStage(s, kind, "codes", stageCodes);
+            timeStage(s, kind, "encode", stageEncode);
+            timeStage(s, kind, "decode", stageDecode);
+            if (memcmp(s->out, data, n) != 0)
+            {
+                printf("Error: %s corpus did not decode to itself\n", corpusNames[kind]);
+                exit(EXIT_FAILURE);
+            }
+            // The same corpus as records, decoded into the output buffer
+            s->nrecords = (n + BENCHRECORD - 1) / BENCHRECORD;
+            s->records = (const unsigned char **)malloc(s->nrecords * sizeof(unsigned char *));
+            s->recordsOut = (unsigned char **)malloc(s->nrecords * sizeof(unsigned char *));
+            s->sizes = (size_t *)malloc(s->nrecords * sizeof(size_t));
+            if (s->records == NULL || s->recordsOut == NULL || s->sizes == NULL)
+            {
+                perror("Memory allocation failed");
+                exit(EXIT_FAILURE);
+            }
+            for (size_t r = 0; r < s->nrecords; r++)
+            {
+                s->records[r] = data + r * BENCHRECORD;
+                s->recordsOut[r] = s->out + r * BENCHRECORD;
+                s->sizes[r] = r + 1 < s->nrecords ? BENCHRECORD : n - r * BENCHRECORD;
+            }
+            memset(s->out, 0, n);
+            modelFromCounts(&s->model, s->counts, 0);
+            stageBatchEncode(s);
+            s->encSize = s->arena.size;
+            timeStage(s, kind, "batch_encode", stageBatchEncode);
+            timeStage(s, kind, "batch_decode", stageBatchDecode);
+            if (memcmp(s->out, data, n) != 0)
+            {
+                printf("Error: %s records did not decode to themselves\n", corpusNames[kind]);
+                exit(EXIT_FAILURE);
+            }
+            freeBatch(&s->arena);
+            freeModel(&s->model);
+            free(s->records);
+            free(s->recordsOut);
+            free(s->sizes);
+            freeTree(&s->ht);
+            free(s->enc);
+            free(s->out);
+            free(data);
+            free(s);
+        }
+    }
+    return 0;
+}
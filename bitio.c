@@ -0,0 +1,445 @@
+#include "bitio.h"
+#include "cpu.h"
+
+void openWriter(BITWRITER *bw, FILE *fp)
+{
+    bw->fp = fp;
+    bw->acc = 0;
+    bw->used = 0;
+    bw->pos = 0;
+    bw->bits = 0;
+    bw->cap = BITBUFSIZE;
+    bw->buf = (unsigned char *)malloc(BITBUFSIZE);
+    if (bw->buf == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void openBufferWriter(BITWRITER *bw)
+{
+    openWriter(bw, NULL);
+}
+
+static void flushBuffer(BITWRITER *bw)
+{
+    if (bw->fp == NULL)
+    {
+        // In memory the buffer grows instead, leaving room for two words
+        if (bw->pos + 16 > bw->cap)
+        {
+            unsigned char *temp = (unsigned char *)realloc(bw->buf, bw->cap * 2);
+            if (temp == NULL)
+            {
+                perror("Memory allocation failed");
+                exit(EXIT_FAILURE);
+            }
+            bw->buf = temp;
+            bw->cap *= 2;
+        }
+        return;
+    }
+    if (bw->pos > 0 && fwrite(bw->buf, 1, bw->pos, bw->fp) != bw->pos)
+    {
+        perror("Error writing output file");
+        exit(EXIT_FAILURE);
+    }
+    bw->pos = 0;
+}
+
+// Stores a word big-endian
+KERNELBODY void storeWord(unsigned char *p, uint64_t w)
+{
+#ifdef WORDBE
+    w = WORDBE(w);
+    memcpy(p, &w, 8);
+#else
+    p[0] = (unsigned char)(w >> 56);
+    p[1] = (unsigned char)(w >> 48);
+    p[2] = (unsigned char)(w >> 40);
+    p[3] = (unsigned char)(w >> 32);
+    p[4] = (unsigned char)(w >> 24);
+    p[5] = (unsigned char)(w >> 16);
+    p[6] = (unsigned char)(w >> 8);
+    p[7] = (unsigned char)w;
+#endif
+}
+
+static void putWord(BITWRITER *bw, uint64_t w)
+{
+    if (bw->pos + 8 > bw->cap)
+        flushBuffer(bw);
+    storeWord(bw->buf + bw->pos, w);
+    bw->pos += 8;
+}
+
+KERNELBODY void putBits(BITWRITER *bw, uint64_t value, int n)
+{
+    if (n == 0)
+        return;
+    if (n < 64)
+        value &= ((uint64_t)1 << n) - 1;
+    bw->bits += n;
+    int space = 64 - bw->used;
+    if (n < space)
+    {
+        bw->acc |= value << (space - n);
+        bw->used += n;
+        return;
+    }
+    // Complete the current word and keep the remaining bits
+    int rest = n - space;
+    bw->acc |= value >> rest;
+    putWord(bw, bw->acc);
+    bw->acc = rest > 0 ? value << (64 - rest) : 0;
+    bw->used = rest;
+}
+
+void writeBits(BITWRITER *bw, uint64_t value, int n)
+{
+    putBits(bw, value, n);
+}
+
+// Code of the k bytes at p, k from 1 to 4, built as two halves so that the
+// shifts don't wait on each other. A byte without a code makes miss negative.
+KERNELBODY uint64_t codeGroup(const CODEENTRY *table, const unsigned char *p, int k, int *len, int *miss)
+{
+    const CODEENTRY *a = &table[p[0]];
+    uint64_t group = a->bits;
+    int groupLen = a->len;
+    int m = a->len - 1;
+    if (k >= 2)
+    {
+        const CODEENTRY *b = &table[p[1]];
+        group = (group << b->len) | b->bits;
+        groupLen += b->len;
+        m |= b->len - 1;
+    }
+    if (k >= 3)
+    {
+        const CODEENTRY *c = &table[p[2]];
+        uint64_t half = c->bits;
+        int halfLen = c->len;
+        m |= c->len - 1;
+        if (k == 4)
+        {
+            const CODEENTRY *d = &table[p[3]];
+            half = (half << d->len) | d->bits;
+            halfLen += d->len;
+            m |= d->len - 1;
+        }
+        group = (group << halfLen) | half;
+        groupLen += halfLen;
+    }
+    *len = groupLen;
+    *miss |= m;
+    return group;
+}
+
+// Packs k codes of at most 56 / k bits per step and stores the whole
+// accumulator after every step, advancing by the complete bytes, so the
+// bits left never decide what a step does. Returns the bytes it coded.
+KERNELBODY size_t packGroups(BITWRITER *bw, const unsigned char *buf, size_t n, const CODEENTRY *table, int k,
+                             int *missing)
+{
+    if (bw->cap - bw->pos < 16)
+        flushBuffer(bw);
+    // Leave fewer than 8 bits pending, so a step can add up to 56
+    uint64_t acc = bw->acc;
+    int used = bw->used;
+    storeWord(bw->buf + bw->pos, acc);
+    bw->pos += used >> 3;
+    acc <<= used & 56;
+    used &= 7;
+    size_t i = 0;
+    unsigned long long bits = 0;
+    int miss = 0;
+    while (n - i >= (size_t)k)
+    {
+        if (bw->cap - bw->pos < 16)
+            flushBuffer(bw);
+        // A step stores 8 bytes and advances by 7 at most
+        size_t steps = (bw->cap - bw->pos - 8) / 7;
+        if (steps > (n - i) / k)
+            steps = (n - i) / k;
+        unsigned char *out = bw->buf + bw->pos;
+        for (size_t s = 0; s < steps; s++, i += k)
+        {
+            int groupLen;
+            uint64_t group = codeGroup(table, buf + i, k, &groupLen, &miss);
+            // The shift only wraps for an empty group, which adds nothing
+            acc |= group << ((64 - used - groupLen) & 63);
+            used += groupLen;
+            bits += groupLen;
+            storeWord(out, acc);
+            out += used >> 3;
+            acc <<= used & 56;
+            used &= 7;
+        }
+        bw->pos = out - bw->buf;
+    }
+    bw->acc = acc;
+    bw->used = used;
+    bw->bits += bits;
+    *missing |= miss < 0;
+    return i;
+}
+
+KERNELBODY int symbolsKernel(BITWRITER *bw, const unsigned char *buf, size_t n, const CODEENTRY *table, int maxLen)
+{
+    int missing = 0;
+    size_t i = 0;
+    // As many codes per step as always fit in 56 bits
+    if (maxLen <= 14)
+        i = packGroups(bw, buf, n, table, 4, &missing);
+    else if (maxLen <= 18)
+        i = packGroups(bw, buf, n, table, 3, &missing);
+    else if (maxLen <= 28)
+        i = packGroups(bw, buf, n, table, 2, &missing);
+    else if (maxLen <= 56)
+        i = packGroups(bw, buf, n, table, 1, &missing);
+    for (; i < n; i++)
+    {
+        const CODEENTRY *e = &table[buf[i]];
+        putBits(bw, e->bits, e->len);
+        missing |= e->len == 0;
+    }
+    return missing ? -1 : 0;
+}
+
+static int symbolsScalar(BITWRITER *bw, const unsigned char *buf, size_t n, const CODEENTRY *table, int maxLen)
+{
+    return symbolsKernel(bw, buf, n, table, maxLen);
+}
+
+#if CPUX86
+// The same loop with shlx/shrx for the shifts and bzhi for the masks
+KERNEL("bmi2") static int symbolsBMI2(BITWRITER *bw, const unsigned char *buf, size_t n, const CODEENTRY *table,
+                                      int maxLen)
+{
+    return symbolsKernel(bw, buf, n, table, maxLen);
+}
+#endif
+
+// The kernel the CPU supports, picked once before main
+static int (*symbolsBest)(BITWRITER *, const unsigned char *, size_t, const CODEENTRY *, int) = symbolsScalar;
+
+#if CPUX86
+KERNELSELECT static void selectSymbols(void)
+{
+    if (cpuFeatures() & CPUBMI2)
+        symbolsBest = symbolsBMI2;
+}
+#endif
+
+int writeSymbols(BITWRITER *bw, const unsigned char *buf, size_t n, const CODEENTRY *table, int maxLen)
+{
+    return symbolsBest(bw, buf, n, table, maxLen);
+}
+
+void flushWriter(BITWRITER *bw)
+{
+    if (bw->fp == NULL)
+        return;
+    flushBuffer(bw);
+    fflush(bw->fp);
+}
+
+void closeWriter(BITWRITER *bw)
+{
+    // Pad the stream to whole words, whatever bytes writeSymbols stored
+    unsigned long long left = (bw->bits + 63) / 64 * 8 - (bw->bits - bw->used) / 8;
+    if (bw->pos + 16 > bw->cap)
+        flushBuffer(bw);
+    storeWord(bw->buf + bw->pos, bw->acc);
+    memset(bw->buf + bw->pos + 8, 0, 8);
+    bw->pos += left;
+    bw->acc = 0;
+    bw->used = 0;
+    if (bw->fp == NULL)
+        return;
+    flushBuffer(bw);
+    free(bw->buf);
+    bw->buf = NULL;
+}
+
+void openReader(BITREADER *br, FILE *fp)
+{
+    br->fp = fp;
+    br->acc = 0;
+    br->avail = 0;
+    br->pos = 0;
+    br->len = 0;
+    br->done = 0;
+    br->eof = 0;
+    br->text = 0;
+    br->buf = (unsigned char *)malloc(BITBUFSIZE);
+    if (br->buf == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void openBufferReader(BITREADER *br, const unsigned char *data, size_t n)
+{
+    br->fp = NULL;
+    br->acc = 0;
+    br->avail = 0;
+    br->pos = 0;
+    br->len = n;
+    br->done = 0;
+    br->eof = 1;
+    br->text = 0;
+    br->buf = (unsigned char *)data;
+}
+
+void openTextReader(BITREADER *br, FILE *fp)
+{
+    openReader(br, fp);
+    br->text = 1;
+}
+
+static void refill(BITREADER *br)
+{
+    if (!br->text && br->avail <= 56 && br->len - br->pos >= 8)
+    {
+        // Load a whole word; the bits past the last whole byte are loaded
+        // again, at the same place, by the next refill
+        uint64_t w = 0;
+        for (int i = 0; i < 8; i++)
+            w = (w << 8) | br->buf[br->pos + i];
+        int take = (64 - br->avail) >> 3;
+        br->acc |= w >> br->avail;
+        br->pos += take;
+        br->avail += 8 * take;
+        return;
+    }
+    while (br->avail <= 56)
+    {
+        if (br->pos == br->len)
+        {
+            if (br->eof)
+                return;
+            br->done += br->len;
+            br->len = fread(br->buf, 1, BITBUFSIZE, br->fp);
+            br->pos = 0;
+            if (br->len == 0)
+            {
+                br->eof = 1;
+                return;
+            }
+        }
+        if (br->text)
+        {
+            unsigned char c = br->buf[br->pos++];
+            if (c == '0' || c == '1')
+            {
+                br->acc |= (uint64_t)(c - '0') << (63 - br->avail);
+                br->avail++;
+            }
+            continue;
+        }
+        br->acc |= (uint64_t)br->buf[br->pos++] << (56 - br->avail);
+        br->avail += 8;
+    }
+}
+
+int moreBits(BITREADER *br)
+{
+    if (br->avail == 0)
+        refill(br);
+    return br->avail > 0;
+}
+
+uint64_t peekBits(BITREADER *br, int n)
+{
+    if (br->avail < n)
+        refill(br);
+    return br->acc >> (64 - n);
+}
+
+int skipBits(BITREADER *br, int n)
+{
+    if (n > br->avail)
+    {
+        br->acc = 0;
+        br->avail = 0;
+        return -1;
+    }
+    br->acc = n < 64 ? br->acc << n : 0;
+    br->avail -= n;
+    return 0;
+}
+
+int readBits(BITREADER *br, int n, uint64_t *value)
+{
+    *value = 0;
+    while (n > 0)
+    {
+        int step = n > 32 ? 32 : n;
+        *value = (*value << step) | peekBits(br, step);
+        if (skipBits(br, step) == -1)
+            return -1;
+        n -= step;
+    }
+    return 0;
+}
+
+uint64_t bitsRead(BITREADER *br)
+{
+    return (br->done + br->pos) * 8 - (uint64_t)br->avail;
+}
+
+void closeReader(BITREADER *br)
+{
+    if (br->fp != NULL)
+        free(br->buf);
+    br->buf = NULL;
+}
+
+void writeU32(FILE *fp, uint32_t v)
+{
+    for (int i = 24; i >= 0; i -= 8)
+        fputc((int)((v >> i) & 0xff), fp);
+}
+
+void writeU64(FILE *fp, uint64_t v)
+{
+    writeU32(fp, (uint32_t)(v >> 32));
+    writeU32(fp, (uint32_t)v);
+}
+
+uint32_t readU32(FILE *fp)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int c = fgetc(fp);
+        if (c == EOF)
+        {
+            printf("Error: File header is truncated\n");
+            exit(EXIT_FAILURE);
+        }
+        v = (v << 8) | (uint32_t)c;
+    }
+    return v;
+}
+
+uint64_t readU64(FILE *fp)
+{
+    uint64_t high = readU32(fp);
+    return (high << 32) | readU32(fp);
+}
+
+int fileMagic(char *filename, const char *magic)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL)
+        return 0;
+    char found[4];
+    int same = fread(found, 1, 4, fp) == 4 && memcmp(found, magic, 4) == 0;
+    fclose(fp);
+    return same;
+}
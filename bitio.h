@@ -0,0 +1,278 @@
+/**
+ * @file bitio.h
+ * @brief Buffered bit writer and bit reader for packed Huffman streams.
+ *
+ * Bits are packed MSB-first into 64-bit words and every word is stored
+ * big-endian, so the resulting byte stream reads MSB-first as well. Both
+ * the writer and the reader go through a large byte buffer, so a file is
+ * touched with one fwrite/fread per buffer instead of one call per bit.
+ *
+ * writeSymbols encodes whole buffers of bytes from a flat table of
+ * (bits, length) pairs, several codes per accumulator update, and stores the
+ * whole accumulator after every update, so it never branches on how many
+ * bits are pending. The stream is still padded to whole words when the
+ * writer is closed.
+ *
+ * Both can also work on memory instead of a file, which is how independent
+ * blocks are coded in parallel (see block.h).
+ *
+ * A bit reader can also be opened in text mode, in which it reads the
+ * textual '0'/'1' format written by printEncFile, so the same decoders work
+ * on both formats.
+ *
+ * @see packed.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef BITIOH
+#define BITIOH
+
+/** Size in bytes of the buffer used by the bit writer and bit reader. */
+#define BITBUFSIZE 65536
+
+/**
+ * @struct BITWRITER
+ * @brief State of a buffered MSB-first bit writer.
+ */
+typedef struct BitWriter
+{
+    FILE *fp;               /**< Output file, NULL when writing to memory */
+    uint64_t acc;           /**< Pending bits, left-aligned */
+    int used;               /**< Number of pending bits in acc */
+    unsigned char *buf;     /**< Output buffer */
+    size_t pos;             /**< Bytes used in buf */
+    size_t cap;             /**< Bytes allocated for buf */
+    unsigned long long bits; /**< Total number of bits written */
+} BITWRITER;
+
+/**
+ * @struct CODEENTRY
+ * @brief Code of one symbol as used by writeSymbols.
+ */
+typedef struct CodeEntry
+{
+    uint64_t bits; /**< Code, right-aligned */
+    int len;       /**< Code length in bits, 0 if the symbol has no code */
+} CODEENTRY;
+
+/**
+ * @struct BITREADER
+ * @brief State of a buffered MSB-first bit reader.
+ */
+typedef struct BitReader
+{
+    FILE *fp;           /**< Input file, NULL when reading from memory */
+    uint64_t acc;       /**< Buffered bits, left-aligned */
+    int avail;          /**< Number of valid bits in acc */
+    unsigned char *buf; /**< Input buffer */
+    size_t pos;         /**< Next unread byte in buf */
+    size_t len;         /**< Number of bytes in buf */
+    uint64_t done;      /**< Bytes read into buf before the current ones */
+    int eof;            /**< Set once the input file is exhausted */
+    int text;           /**< Set if the input is made of '0'/'1' characters */
+} BITREADER;
+
+/**
+ * @brief Initializes a bit writer on an open file.
+ *
+ * @param bw Bit writer to initialize.
+ * @param fp Output file, positioned where the bitstream starts.
+ * @return void
+ */
+void openWriter(BITWRITER *, FILE *);
+
+/**
+ * @brief Initializes a bit writer that writes into a growing memory buffer.
+ *
+ * After closeWriter the bitstream is in bw->buf (bw->pos bytes), and the
+ * caller has to free bw->buf.
+ *
+ * @param bw Bit writer to initialize.
+ * @return void
+ */
+void openBufferWriter(BITWRITER *);
+
+/**
+ * @brief Appends the low n bits of a value to the stream, MSB first.
+ *
+ * @param bw Bit writer.
+ * @param value Bits to write, right-aligned.
+ * @param n Number of bits, from 0 to 64.
+ * @return void
+ */
+void writeBits(BITWRITER *, uint64_t, int);
+
+/**
+ * @brief Appends the codes of a buffer of bytes to the stream.
+ *
+ * Produces the same bits as calling writeBits for every byte, but packs
+ * 64 / maxLen codes into a register with shifts and ORs before handing them
+ * to the writer, so the inner loop has no branch per code.
+ *
+ * @param bw Bit writer.
+ * @param buf Bytes to encode.
+ * @param n Number of bytes.
+ * @param table Code of every byte value.
+ * @param maxLen Longest code length in the table.
+ * @return 0 on success, -1 if a byte has no code (its code is written as
+ *         zero bits).
+ */
+int writeSymbols(BITWRITER *, const unsigned char *, size_t, const CODEENTRY *, int);
+
+/**
+ * @brief Writes out every complete word to the output file right away.
+ *
+ * The bits of the word that is not complete yet stay in the writer. Used to
+ * keep the latency of live streams low.
+ *
+ * @param bw Bit writer on a file.
+ * @return void
+ */
+void flushWriter(BITWRITER *);
+
+/**
+ * @brief Pads the last word with zeros, writes out the buffer and frees it.
+ *
+ * A writer that writes to memory keeps its buffer.
+ *
+ * @param bw Bit writer.
+ * @return void
+ */
+void closeWriter(BITWRITER *);
+
+/**
+ * @brief Initializes a bit reader on an open file.
+ *
+ * @param br Bit reader to initialize.
+ * @param fp Input file, positioned where the bitstream starts.
+ * @return void
+ */
+void openReader(BITREADER *, FILE *);
+
+/**
+ * @brief Initializes a bit reader on a bitstream in memory.
+ *
+ * @param br Bit reader to initialize.
+ * @param data Bitstream, which must stay valid while the reader is used.
+ * @param n Number of bytes in the bitstream.
+ * @return void
+ */
+void openBufferReader(BITREADER *, const unsigned char *, size_t);
+
+/**
+ * @brief Initializes a bit reader on a file in the textual '0'/'1' format.
+ *
+ * Every '0' or '1' character is one bit, any other character is skipped.
+ *
+ * @param br Bit reader to initialize.
+ * @param fp Input file.
+ * @return void
+ */
+void openTextReader(BITREADER *, FILE *);
+
+/**
+ * @brief Checks if there are bits left to read.
+ *
+ * @param br Bit reader.
+ * @return 1 if at least one more bit can be read, 0 otherwise.
+ */
+int moreBits(BITREADER *);
+
+/**
+ * @brief Returns the next n bits without consuming them.
+ *
+ * Bits past the end of the input are returned as zeros.
+ *
+ * @param br Bit reader.
+ * @param n Number of bits, from 1 to 56.
+ * @return The bits, right-aligned.
+ */
+uint64_t peekBits(BITREADER *, int);
+
+/**
+ * @brief Consumes n bits that were previously peeked.
+ *
+ * @param br Bit reader.
+ * @param n Number of bits, at most the number peeked.
+ * @return 0 on success, -1 if the input ended before n bits were available.
+ */
+int skipBits(BITREADER *, int);
+
+/**
+ * @brief Reads and consumes the next n bits.
+ *
+ * @param br Bit reader.
+ * @param n Number of bits, from 0 to 64.
+ * @param value Pointer to store the bits, right-aligned.
+ * @return 0 on success, -1 if the input ended before n bits were available.
+ */
+int readBits(BITREADER *, int, uint64_t *);
+
+/**
+ * @brief Counts the bits consumed from a binary bit reader.
+ *
+ * @param br Bit reader, not on the textual format.
+ * @return Number of bits consumed since the reader was opened.
+ */
+uint64_t bitsRead(BITREADER *);
+
+/**
+ * @brief Frees the buffer of a bit reader.
+ *
+ * @param br Bit reader.
+ * @return void
+ */
+void closeReader(BITREADER *);
+
+/**
+ * @brief Writes a 32-bit integer to a file, big-endian.
+ *
+ * @param fp Output file.
+ * @param v Value to write.
+ * @return void
+ */
+void writeU32(FILE *, uint32_t);
+
+/**
+ * @brief Writes a 64-bit integer to a file, big-endian.
+ *
+ * @param fp Output file.
+ * @param v Value to write.
+ * @return void
+ */
+void writeU64(FILE *, uint64_t);
+
+/**
+ * @brief Reads a big-endian 32-bit integer from a file header.
+ *
+ * Exits with an error if the file ends first.
+ *
+ * @param fp Input file.
+ * @return The value read.
+ */
+uint32_t readU32(FILE *);
+
+/**
+ * @brief Reads a big-endian 64-bit integer from a file header.
+ *
+ * Exits with an error if the file ends first.
+ *
+ * @param fp Input file.
+ * @return The value read.
+ */
+uint64_t readU64(FILE *);
+
+/**
+ * @brief Checks if a file starts with the given 4 byte magic.
+ *
+ * @param filename File name.
+ * @param magic The 4 magic bytes.
+ * @return 1 if it does, 0 otherwise or if the file can't be opened.
+ */
+int fileMagic(char *, const char *);
+
+#endif
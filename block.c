@@ -0,0 +1,759 @@
+#include "block.h"
+#include "histogram.h"
+#include "mapfile.h"
+#include "stats.h"
+
+/**
+ * @struct BLOCKCTX
+ * @brief What the block jobs of one file share.
+ */
+typedef struct BlockCtx
+{
+    BLOCKJOB *jobs;            /**< Jobs of the current round */
+    uint64_t base;             /**< Number of the first block of the current round */
+    int global;                /**< 1 if all blocks use the table below */
+    int streams;               /**< Number of streams in every block */
+    int maxLen;                /**< Longest allowed code length, 0 for no limit */
+    int transforms;            /**< Transforms applied to every block */
+    int keep;                  /**< 1 if countJob keeps the transformed bytes */
+    int len[MAXSYMBOLS];       /**< Global code lengths */
+    uint64_t bits[MAXSYMBOLS]; /**< Global canonical codes */
+    DECODETABLE dt;            /**< Global decoding table */
+} BLOCKCTX;
+
+/**
+ * @struct BLOCKIO
+ * @brief What the I/O stage of one file needs between rounds.
+ *
+ * The stage writes the pending blocks of a set of jobs and then reads the
+ * next round into the same set, while the pool codes the other set.
+ */
+typedef struct BlockIO
+{
+    BLOCKJOB *jobs;     /**< Job set written and then read into */
+    int pending;        /**< Number of coded jobs in the set to write first */
+    int got;            /**< Number of jobs read into the set */
+    int round;          /**< Number of jobs in every set */
+    INPUTFILE *in;      /**< Uncoded input when encoding */
+    uint64_t offset;    /**< Offset of the next block in a mapped input */
+    FILE *src;          /**< Block file when decoding */
+    FILE *dst;          /**< Output file */
+    char *input;        /**< Input file name, for errors */
+    uint32_t *index;    /**< Coded size of every block */
+    uint64_t block;     /**< Blocks written when encoding, read when decoding */
+    uint64_t nblocks;   /**< Number of blocks in the file */
+    uint32_t blockSize; /**< Uncoded size of every block but the last */
+    uint64_t length;    /**< Uncoded length of the file */
+    BLOCKJOB *kept;     /**< Transformed bytes of every block from the counting pass, or NULL */
+    uint64_t read;      /**< Number of blocks read so far */
+} BLOCKIO;
+
+// Makes job->work hold at least n bytes
+static void reserveWork(BLOCKJOB *job, size_t n)
+{
+    if (n <= job->workCap)
+        return;
+    free(job->work);
+    job->work = (unsigned char *)malloc(n);
+    if (job->work == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    job->workCap = n;
+}
+
+// Applies the transforms to the raw bytes of a job and returns the bytes to
+// code. work holds two halves of RLEBOUND(rawLen) bytes, the second for RLE.
+static const unsigned char *forwardBlock(BLOCKJOB *job, int transforms, size_t *n, uint32_t *primary)
+{
+    size_t bound = RLEBOUND(job->rawLen);
+    const unsigned char *src = job->raw;
+    *n = job->rawLen;
+    *primary = 0;
+    if (transforms == 0)
+        return src;
+    reserveWork(job, 2 * bound);
+    if (transforms & BLOCKBWT)
+    {
+        *primary = bwtForward(src, job->work, job->rawLen);
+        src = job->work;
+    }
+    if (transforms & BLOCKMTF)
+    {
+        if (src != job->work)
+            memcpy(job->work, src, job->rawLen);
+        mtfForward(job->work, job->rawLen);
+        src = job->work;
+    }
+    if (transforms & BLOCKRLE)
+    {
+        *n = rleForward(src, job->rawLen, job->work + bound);
+        src = job->work + bound;
+    }
+    return src;
+}
+
+// Undoes the transforms of n decoded bytes at the start of work into raw
+static int inverseBlock(BLOCKJOB *job, int transforms, size_t n, uint32_t primary)
+{
+    size_t bound = RLEBOUND(job->rawLen);
+    unsigned char *src = job->work;
+    if (transforms & BLOCKRLE)
+    {
+        // Straight into raw when nothing else is left to undo
+        unsigned char *dst = (transforms & (BLOCKBWT | BLOCKMTF)) ? job->work + bound : job->raw;
+        if (rleInverse(src, n, dst, job->rawLen) != (long long)job->rawLen)
+            return -1;
+        src = dst;
+    }
+    else if (n != job->rawLen)
+        return -1;
+    if (transforms & BLOCKMTF)
+        mtfInverse(src, job->rawLen);
+    if (transforms & BLOCKBWT)
+        return bwtInverse(src, job->raw, job->rawLen, primary);
+    if (src != job->raw)
+        memcpy(job->raw, src, job->rawLen);
+    return 0;
+}
+
+static void countJob(void *arg, int j)
+{
+    BLOCKCTX *ctx = (BLOCKCTX *)arg;
+    BLOCKJOB *job = &ctx->jobs[j];
+    size_t n;
+    uint32_t primary;
+    const unsigned char *src = forwardBlock(job, ctx->transforms, &n, &primary);
+    for (int i = 0; i < SYMBOLS; i++)
+        job->counts[i] = 0;
+    countBuffer(src, n, job->counts);
+    if (!ctx->keep)
+        return;
+    // The work buffer goes to the block, so the encode pass needn't
+    // transform it again
+    if (src != job->work)
+        memmove(job->work, src, n);
+    job->ready = (unsigned char *)realloc(job->work, n > 0 ? n : 1);
+    if (job->ready == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    job->readyLen = n;
+    job->primary = primary;
+    job->work = NULL;
+    job->workCap = 0;
+}
+
+void encodeBlock(BLOCKJOB *job, int *len, uint64_t *bits, int streams, int maxLen, int transforms)
+{
+    int blockLen[MAXSYMBOLS];
+    uint64_t blockBits[MAXSYMBOLS];
+    BITWRITER bw;
+    openBufferWriter(&bw);
+    size_t size = job->readyLen;
+    uint32_t primary = job->primary;
+    const unsigned char *src = job->ready;
+    if (src == NULL)
+        src = forwardBlock(job, transforms, &size, &primary);
+    if (transforms != 0)
+    {
+        // Two words keep the parts after them aligned to 64 bits
+        writeBits(&bw, size, 32);
+        writeBits(&bw, primary, 32);
+    }
+    if (len == NULL)
+    {
+        uint64_t counts[MAXSYMBOLS];
+        for (int i = 0; i < MAXSYMBOLS; i++)
+            counts[i] = 0;
+        countBuffer(src, size, counts);
+        huffmanLengths(counts, blockLen, &job->tree, maxLen);
+        canonicalCodes(blockLen, blockBits, MAXSYMBOLS);
+        len = blockLen;
+        bits = blockBits;
+        for (int i = 0; i < SYMBOLS; i++)
+            writeBits(&bw, (uint64_t)len[i], 8);
+    }
+    CODEENTRY table[SYMBOLS];
+    int longest = encodeTable(table, len, bits, SYMBOLS);
+    if (streams == 1)
+    {
+        uint64_t start = bw.bits;
+        writeSymbols(&bw, src, size, table, longest);
+        job->payload = bw.bits - start;
+        closeWriter(&bw);
+    }
+    else
+    {
+        // Code every part into its own stream, then append them after the
+        // jump table
+        BITWRITER part[BLOCKSTREAMS];
+        size_t partLen = size / BLOCKSTREAMS;
+        job->payload = 0;
+        for (int s = 0; s < BLOCKSTREAMS; s++)
+        {
+            size_t n = s == BLOCKSTREAMS - 1 ? size - s * partLen : partLen;
+            openBufferWriter(&part[s]);
+            writeSymbols(&part[s], src + s * partLen, n, table, longest);
+            job->payload += part[s].bits;
+            closeWriter(&part[s]);
+            writeBits(&bw, part[s].pos, 32);
+        }
+        closeWriter(&bw);
+        for (int s = 0; s < BLOCKSTREAMS; s++)
+        {
+            while (bw.pos + part[s].pos > bw.cap)
+            {
+                bw.cap *= 2;
+                unsigned char *temp = (unsigned char *)realloc(bw.buf, bw.cap);
+                if (temp == NULL)
+                {
+                    perror("Memory allocation failed");
+                    exit(EXIT_FAILURE);
+                }
+                bw.buf = temp;
+            }
+            memcpy(bw.buf + bw.pos, part[s].buf, part[s].pos);
+            bw.pos += part[s].pos;
+            free(part[s].buf);
+        }
+    }
+    free(job->coded);
+    job->coded = bw.buf;
+    job->codedLen = bw.pos;
+    job->codedCap = bw.cap;
+}
+
+int decodeBlock(BLOCKJOB *job, DECODETABLE *dt, int streams, int transforms)
+{
+    BITREADER br[BLOCKSTREAMS];
+    openBufferReader(&br[0], job->coded, job->codedLen);
+    // Empty until the jump table is read, so every reader can be closed
+    for (int s = 1; s < streams; s++)
+        openBufferReader(&br[s], job->coded, 0);
+    size_t size = job->rawLen;
+    uint32_t primary = 0;
+    size_t head = 0;
+    if (transforms != 0)
+    {
+        uint64_t v = 0;
+        int bad = readBits(&br[0], 32, &v) == -1;
+        size = (size_t)v;
+        bad |= readBits(&br[0], 32, &v) == -1;
+        primary = (uint32_t)v;
+        head = 8;
+        if (bad || size > RLEBOUND(job->rawLen))
+        {
+            closeReader(&br[0]);
+            return -1;
+        }
+        reserveWork(job, 2 * RLEBOUND(job->rawLen));
+    }
+    DECODETABLE blockTable;
+    if (dt == NULL)
+    {
+        int len[MAXSYMBOLS];
+        len[EOS] = 0;
+        for (int i = 0; i < SYMBOLS; i++)
+        {
+            uint64_t v;
+            len[i] = readBits(&br[0], 8, &v) == -1 ? -1 : (int)v;
+        }
+        if (tableFromLengths(&blockTable, len, MAXSYMBOLS) == -1)
+            return -1;
+        dt = &blockTable;
+    }
+    int status = 0;
+    if (streams > 1)
+    {
+        // The jump table gives the size of every stream in bytes
+        size_t start = head + (dt == &blockTable ? SYMBOLS : 0) + 4 * BLOCKSTREAMS;
+        size_t streamLen[BLOCKSTREAMS];
+        size_t total = start;
+        for (int s = 0; s < BLOCKSTREAMS; s++)
+        {
+            uint64_t v = 0;
+            if (readBits(&br[0], 32, &v) == -1)
+                status = -1;
+            streamLen[s] = (size_t)v;
+            total += streamLen[s];
+        }
+        if (status == 0 && total != job->codedLen)
+            status = -1;
+        for (int s = 0; status == 0 && s < BLOCKSTREAMS; s++)
+        {
+            openBufferReader(&br[s], job->coded + start, streamLen[s]);
+            start += streamLen[s];
+        }
+    }
+    // The header fields read from the first stream are not payload
+    uint64_t header = streams == 1 ? bitsRead(&br[0]) : 0;
+    if (status == 0)
+        status = decodeStreams(dt, br, streams, transforms != 0 ? job->work : job->raw, size);
+    job->payload = 0;
+    for (int s = 0; s < streams; s++)
+        job->payload += bitsRead(&br[s]);
+    job->payload -= header;
+    if (status == 0 && transforms != 0)
+        status = inverseBlock(job, transforms, size, primary);
+    if (dt == &blockTable)
+        freeTable(&blockTable);
+    for (int s = 0; s < streams; s++)
+        closeReader(&br[s]);
+    return status;
+}
+
+static void encodeJob(void *arg, int j)
+{
+    BLOCKCTX *ctx = (BLOCKCTX *)arg;
+    if (ctx->global)
+        encodeBlock(&ctx->jobs[j], ctx->len, ctx->bits, ctx->streams, 0, ctx->transforms);
+    else
+        encodeBlock(&ctx->jobs[j], NULL, NULL, ctx->streams, ctx->maxLen, ctx->transforms);
+}
+
+static void decodeJob(void *arg, int j)
+{
+    BLOCKCTX *ctx = (BLOCKCTX *)arg;
+    if (decodeBlock(&ctx->jobs[j], ctx->global ? &ctx->dt : NULL, ctx->streams, ctx->transforms) == -1)
+    {
+        printf("Error: Block %llu is truncated or corrupted\n", (unsigned long long)(ctx->base + j));
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Reads up to n blocks into the jobs, returns the number read. The blocks of
+// a mapped file point into the mapping instead of being copied.
+static int readRound(INPUTFILE *in, uint64_t *offset, BLOCKJOB *jobs, int n)
+{
+    int k = 0;
+    while (k < n)
+    {
+        if (in->mapped)
+        {
+            size_t left = in->size - *offset;
+            jobs[k].raw = in->data + *offset;
+            jobs[k].rawLen = left < BLOCKSIZE ? left : BLOCKSIZE;
+            *offset += jobs[k].rawLen;
+        }
+        else
+            jobs[k].rawLen = fread(jobs[k].raw, 1, BLOCKSIZE, in->fp);
+        if (jobs[k].rawLen == 0)
+            break;
+        k++;
+    }
+    return k;
+}
+
+// Allocates n jobs, with a raw buffer each unless raw is 0
+static BLOCKJOB *allocJobs(int n, int raw)
+{
+    BLOCKJOB *jobs = (BLOCKJOB *)malloc(n * sizeof(BLOCKJOB));
+    if (jobs == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        jobs[i].raw = raw ? (unsigned char *)malloc(BLOCKSIZE) : NULL;
+        if (raw && jobs[i].raw == NULL)
+        {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        jobs[i].coded = NULL;
+        jobs[i].codedLen = 0;
+        jobs[i].codedCap = 0;
+        jobs[i].work = NULL;
+        jobs[i].workCap = 0;
+        jobs[i].ready = NULL;
+        jobs[i].tree = (HUFFTREE){NULL, 0, -1, 0, NULL};
+    }
+    return jobs;
+}
+
+static void freeJobs(BLOCKJOB *jobs, int n, int raw)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (raw)
+            free(jobs[i].raw);
+        free(jobs[i].coded);
+        free(jobs[i].work);
+        freeTree(&jobs[i].tree);
+    }
+    free(jobs);
+}
+
+// Reads the next round to encode, with the bytes kept for its blocks
+static void readEncode(BLOCKIO *io)
+{
+    io->got = readRound(io->in, &io->offset, io->jobs, io->round);
+    for (int k = 0; k < io->got; k++, io->read++)
+    {
+        io->jobs[k].ready = NULL;
+        if (io->kept != NULL && io->read < io->nblocks)
+        {
+            io->jobs[k].ready = io->kept[io->read].ready;
+            io->jobs[k].readyLen = io->kept[io->read].readyLen;
+            io->jobs[k].primary = io->kept[io->read].primary;
+        }
+    }
+}
+
+// Writes the coded pending blocks and reads the next round to encode
+static void encodeIO(void *arg)
+{
+    BLOCKIO *io = (BLOCKIO *)arg;
+    for (int j = 0; j < io->pending; j++)
+    {
+        if (io->kept != NULL && io->block < io->nblocks)
+        {
+            free(io->kept[io->block].ready);
+            io->kept[io->block].ready = NULL;
+        }
+        if (fwrite(io->jobs[j].coded, 1, io->jobs[j].codedLen, io->dst) != io->jobs[j].codedLen)
+        {
+            perror("Error writing output file");
+            exit(EXIT_FAILURE);
+        }
+        STATPAYLOAD(io->jobs[j].payload);
+        if (io->block < io->nblocks)
+            io->index[io->block] = (uint32_t)io->jobs[j].codedLen;
+        io->block++;
+    }
+    readEncode(io);
+}
+
+// Writes the decoded pending blocks and reads the next round to decode
+static void decodeIO(void *arg)
+{
+    BLOCKIO *io = (BLOCKIO *)arg;
+    for (int j = 0; j < io->pending; j++)
+    {
+        if (fwrite(io->jobs[j].raw, 1, io->jobs[j].rawLen, io->dst) != io->jobs[j].rawLen)
+        {
+            perror("Error writing output file");
+            exit(EXIT_FAILURE);
+        }
+        STATPAYLOAD(io->jobs[j].payload);
+    }
+    int k = 0;
+    for (; k < io->round && io->block < io->nblocks; k++, io->block++)
+    {
+        BLOCKJOB *job = &io->jobs[k];
+        uint64_t b = io->block;
+        job->rawLen = b + 1 < io->nblocks ? io->blockSize : (size_t)(io->length - b * io->blockSize);
+        job->codedLen = io->index[b];
+        if (job->codedLen > job->codedCap)
+        {
+            free(job->coded);
+            job->coded = (unsigned char *)malloc(job->codedLen);
+            if (job->coded == NULL)
+            {
+                perror("Memory allocation failed");
+                exit(EXIT_FAILURE);
+            }
+            job->codedCap = job->codedLen;
+        }
+        if (fread(job->coded, 1, job->codedLen, io->src) != job->codedLen)
+        {
+            printf("Error: %s is truncated\n", io->input);
+            exit(EXIT_FAILURE);
+        }
+    }
+    io->got = k;
+}
+
+// Codes the rounds of a file with two job sets: while the pool codes one,
+// the I/O stage writes the round before from the other and reads the next
+// round into it. The first round must already be read into sets[0].
+static void pipeline(THREADPOOL *pool, BLOCKCTX *ctx, BLOCKJOB **sets, int k, BLOCKIO *io,
+                     void (*job)(void *, int), void (*stageIO)(void *))
+{
+    STAGE stage;
+    createStage(&stage);
+    int cur = 0;
+    int pending = 0;
+    ctx->base = 0;
+    while (k > 0)
+    {
+        io->jobs = sets[1 - cur];
+        io->pending = pending;
+        startStage(&stage, stageIO, io);
+        ctx->jobs = sets[cur];
+        runPool(pool, k, job, ctx);
+        waitStage(&stage);
+        ctx->base += k;
+        pending = k;
+        k = io->got;
+        cur = 1 - cur;
+    }
+    destroyStage(&stage);
+    // The last round coded is still to be written, and nothing is left to read
+    io->jobs = sets[1 - cur];
+    io->pending = pending;
+    stageIO(io);
+}
+
+void compressBlocks(char *input, char *output, int threads, int global, int split, int maxLen, int transforms)
+{
+    double timer = STATBEGIN();
+    INPUTFILE in;
+    if (openInput(&in, input) == -1)
+    {
+        perror("Error opening input file");
+        exit(EXIT_FAILURE);
+    }
+    uint64_t length = in.size;
+    if (!in.mapped)
+    {
+        // The length goes into the header, so the input can't be a pipe
+        long end = fseek(in.fp, 0, SEEK_END) == 0 ? ftell(in.fp) : -1;
+        if (end < 0)
+        {
+            printf("Error: %s is not seekable\n", input);
+            closeInput(&in);
+            exit(EXIT_FAILURE);
+        }
+        length = (uint64_t)end;
+        rewind(in.fp);
+    }
+    uint64_t offset = 0;
+    uint64_t nblocks = (length + BLOCKSIZE - 1) / BLOCKSIZE;
+    FILE *fp2 = fopen(output, "wb");
+    if (fp2 == NULL)
+    {
+        perror("Error opening output file");
+        closeInput(&in);
+        exit(EXIT_FAILURE);
+    }
+    THREADPOOL pool;
+    createPool(&pool, threads);
+    int round = (pool.threads + 1) * BLOCKSPERTHREAD;
+    BLOCKCTX *ctx = (BLOCKCTX *)malloc(sizeof(BLOCKCTX));
+    uint32_t *index = (uint32_t *)malloc((nblocks + 1) * sizeof(uint32_t));
+    if (ctx == NULL || index == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    BLOCKJOB *sets[2] = {allocJobs(round, !in.mapped), allocJobs(round, !in.mapped)};
+    ctx->jobs = sets[0];
+    ctx->global = global;
+    ctx->streams = split ? BLOCKSTREAMS : 1;
+    ctx->maxLen = maxLen;
+    ctx->transforms = transforms;
+    // The transformed blocks of the counting pass are kept for the encode
+    // pass, which costs memory for the whole file but transforms it once
+    ctx->keep = global && transforms != 0 && length > 0;
+    BLOCKJOB *kept = NULL;
+    if (ctx->keep)
+    {
+        kept = (BLOCKJOB *)calloc(nblocks, sizeof(BLOCKJOB));
+        if (kept == NULL)
+        {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (global && length > 0)
+    {
+        // First pass: count every block in parallel and merge the counts
+        uint64_t counts[MAXSYMBOLS];
+        for (int i = 0; i < MAXSYMBOLS; i++)
+            counts[i] = 0;
+        uint64_t counted = 0;
+        int k;
+        while ((k = readRound(&in, &offset, ctx->jobs, round)) > 0)
+        {
+            runPool(&pool, k, countJob, ctx);
+            for (int j = 0; j < k; j++, counted++)
+            {
+                for (int i = 0; i < SYMBOLS; i++)
+                    counts[i] += ctx->jobs[j].counts[i];
+                if (ctx->keep && counted < nblocks)
+                {
+                    kept[counted].ready = ctx->jobs[j].ready;
+                    kept[counted].readyLen = ctx->jobs[j].readyLen;
+                    kept[counted].primary = ctx->jobs[j].primary;
+                }
+                else if (ctx->keep)
+                    free(ctx->jobs[j].ready);
+                ctx->jobs[j].ready = NULL;
+            }
+        }
+        offset = 0;
+        rewindInput(&in);
+        HUFFTREE ht = {NULL, 0, -1, 0, NULL};
+        huffmanLengths(counts, ctx->len, &ht, maxLen);
+        if (maxLen > 0)
+            reportLimit(counts, ctx->len, &ht, maxLen);
+        freeTree(&ht);
+        canonicalCodes(ctx->len, ctx->bits, MAXSYMBOLS);
+    }
+    fwrite(BLOCKMAGIC, 1, 4, fp2);
+    fputc(BLOCKVERSION, fp2);
+    fputc((global ? BLOCKGLOBAL : 0) | (split ? BLOCKSPLIT : 0) | transforms, fp2);
+    writeU32(fp2, BLOCKSIZE);
+    writeU64(fp2, length);
+    if (global)
+        for (int i = 0; i < SYMBOLS; i++)
+            fputc(length > 0 ? ctx->len[i] : 0, fp2);
+    long indexPos = ftell(fp2);
+    for (uint64_t b = 0; b < nblocks; b++)
+        writeU32(fp2, 0); // patched once the block sizes are known
+    BLOCKIO io;
+    io.round = round;
+    io.in = &in;
+    io.offset = 0;
+    io.dst = fp2;
+    io.index = index;
+    io.block = 0;
+    io.nblocks = nblocks;
+    io.kept = kept;
+    io.read = 0;
+    io.jobs = sets[0];
+    readEncode(&io);
+    pipeline(&pool, ctx, sets, io.got, &io, encodeJob, encodeIO);
+    if (io.block != nblocks)
+    {
+        printf("Error: %s changed while it was being compressed\n", input);
+        exit(EXIT_FAILURE);
+    }
+    fseek(fp2, indexPos, SEEK_SET);
+    for (uint64_t b = 0; b < nblocks; b++)
+        writeU32(fp2, index[b]);
+    destroyPool(&pool);
+    freeJobs(sets[0], round, !in.mapped);
+    freeJobs(sets[1], round, !in.mapped);
+    for (uint64_t b = 0; kept != NULL && b < nblocks; b++)
+        free(kept[b].ready);
+    free(kept);
+    free(ctx);
+    free(index);
+    closeInput(&in);
+    if (fclose(fp2) != 0)
+    {
+        perror("Error writing output file");
+        exit(EXIT_FAILURE);
+    }
+    STATEND(STATENCODE, timer, length);
+}
+
+void decompBlocks(char *input, char *output, int threads)
+{
+    double timer = STATBEGIN();
+    FILE *fp1 = fopen(input, "rb");
+    if (fp1 == NULL)
+    {
+        perror("Error opening input file");
+        exit(EXIT_FAILURE);
+    }
+    char magic[4];
+    if (fread(magic, 1, 4, fp1) != 4 || memcmp(magic, BLOCKMAGIC, 4) != 0)
+    {
+        printf("Error: %s is not a block file\n", input);
+        fclose(fp1);
+        exit(EXIT_FAILURE);
+    }
+    int version = fgetc(fp1);
+    int flags = fgetc(fp1);
+    if (version != BLOCKVERSION || flags == EOF || (flags & ~(BLOCKGLOBAL | BLOCKSPLIT | BLOCKTRANSFORMS)) != 0)
+    {
+        printf("Error: Unsupported block format version %d\n", version);
+        fclose(fp1);
+        exit(EXIT_FAILURE);
+    }
+    uint32_t blockSize = readU32(fp1);
+    uint64_t length = readU64(fp1);
+    if (blockSize == 0 || blockSize > BLOCKSIZE)
+    {
+        printf("Error: Unsupported block size %lu\n", (unsigned long)blockSize);
+        fclose(fp1);
+        exit(EXIT_FAILURE);
+    }
+    BLOCKCTX *ctx = (BLOCKCTX *)malloc(sizeof(BLOCKCTX));
+    if (ctx == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    ctx->global = (flags & BLOCKGLOBAL) != 0;
+    ctx->streams = (flags & BLOCKSPLIT) != 0 ? BLOCKSTREAMS : 1;
+    ctx->transforms = flags & BLOCKTRANSFORMS;
+    if (ctx->global)
+    {
+        ctx->len[EOS] = 0;
+        for (int i = 0; i < SYMBOLS; i++)
+        {
+            ctx->len[i] = fgetc(fp1);
+            if (ctx->len[i] == EOF)
+            {
+                printf("Error: File header is truncated\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (tableFromLengths(&ctx->dt, ctx->len, MAXSYMBOLS) == -1)
+        {
+            printf("Error: %s has a corrupted code table\n", input);
+            exit(EXIT_FAILURE);
+        }
+    }
+    uint64_t nblocks = (length + blockSize - 1) / blockSize;
+    uint32_t *index = (uint32_t *)malloc((nblocks + 1) * sizeof(uint32_t));
+    if (index == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (uint64_t b = 0; b < nblocks; b++)
+        index[b] = readU32(fp1);
+    if (feof(fp1) || ferror(fp1))
+    {
+        printf("Error: File header is truncated\n");
+        exit(EXIT_FAILURE);
+    }
+    FILE *fp2 = fopen(output, "wb");
+    if (fp2 == NULL)
+    {
+        perror("Error opening output file");
+        fclose(fp1);
+        exit(EXIT_FAILURE);
+    }
+    THREADPOOL pool;
+    createPool(&pool, threads);
+    int round = (pool.threads + 1) * BLOCKSPERTHREAD;
+    BLOCKJOB *sets[2] = {allocJobs(round, 1), allocJobs(round, 1)};
+    BLOCKIO io;
+    io.jobs = sets[0];
+    io.pending = 0;
+    io.round = round;
+    io.src = fp1;
+    io.dst = fp2;
+    io.input = input;
+    io.index = index;
+    io.block = 0;
+    io.nblocks = nblocks;
+    io.blockSize = blockSize;
+    io.length = length;
+    decodeIO(&io);
+    pipeline(&pool, ctx, sets, io.got, &io, decodeJob, decodeIO);
+    destroyPool(&pool);
+    freeJobs(sets[0], round, 1);
+    freeJobs(sets[1], round, 1);
+    if (ctx->global)
+        freeTable(&ctx->dt);
+    free(ctx);
+    free(index);
+    fclose(fp1);
+    if (fclose(fp2) != 0)
+    {
+        perror("Error writing output file");
+        exit(EXIT_FAILURE);
+    }
+    STATEND(STATDECODE, timer, length);
+}
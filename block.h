@@ -0,0 +1,168 @@
+/**
+ * @file block.h
+ * @brief Block-parallel Huffman compression.
+ *
+ * The input is split into blocks of BLOCKSIZE bytes that are coded
+ * independently, so a thread pool (see pool.h) can count, encode and decode
+ * many blocks at the same time. A block file consists of:
+ *
+ * - a 4 byte magic "HUFB" and a 1 byte format version,
+ * - a 1 byte flags field (BLOCKGLOBAL if all blocks share one code table,
+ *   BLOCKSPLIT if every block is split into BLOCKSTREAMS streams, and
+ *   BLOCKBWT, BLOCKMTF and BLOCKRLE for the transforms of every block),
+ * - the block size as a 32-bit and the original length as a 64-bit
+ *   big-endian integer,
+ * - with BLOCKGLOBAL, 256 bytes with the code length of every byte value,
+ * - the index: the compressed size of every block as a 32-bit integer,
+ * - the blocks. With any transform, a block starts with the number of
+ *   transformed bytes and the row returned by bwtForward (0 without
+ *   BLOCKBWT) as two 32-bit integers. Without BLOCKGLOBAL every block
+ *   then has its own 256 code lengths. The bitstream of a block is packed MSB-first into 64-bit
+ *   words, like in the packed format.
+ *
+ * With BLOCKSPLIT the bytes of a block are cut into BLOCKSTREAMS parts (the
+ * last one taking the remainder) that are coded into separate bitstreams.
+ * After the code lengths, a block then has a jump table with the size in
+ * bytes of every stream as a 32-bit integer, followed by the streams. The
+ * decoder advances all of them in one loop (see decodeStreams in lookup.h),
+ * which hides the dependency of every code on the length of the one before.
+ *
+ * The transforms (see transform.h) run on every block independently before
+ * it is coded, so the thread pool also runs them in parallel. With a global
+ * table they run in the counting pass too, since the table is built from
+ * the transformed bytes.
+ *
+ * The file is processed in rounds of a few blocks per thread, so memory use
+ * does not depend on the size of the input, except that a global table with
+ * transforms keeps the transformed blocks of the counting pass for the
+ * encode pass. Two rounds are in flight: the
+ * pool codes one while a stage thread writes the round before and reads the
+ * next one.
+ *
+ * @see pool.h
+ * @see packed.h
+ */
+
+#include "bitio.h"
+#include "canonical.h"
+#include "huffmanTree.h"
+#include "lookup.h"
+#include "pool.h"
+#include "transform.h"
+
+#ifndef BLOCKH
+#define BLOCKH
+
+/** Magic bytes at the start of every block file. */
+#define BLOCKMAGIC "HUFB"
+
+/** Current version of the block format. */
+#define BLOCKVERSION 1
+
+/** Flag set when all blocks are coded with one global code table. */
+#define BLOCKGLOBAL 0x01
+
+/** Flag set when every block is split into BLOCKSTREAMS streams. */
+#define BLOCKSPLIT 0x02
+
+/** Flag set when every block is Burrows-Wheeler transformed. */
+#define BLOCKBWT 0x04
+
+/** Flag set when every block is move-to-front transformed. */
+#define BLOCKMTF 0x08
+
+/** Flag set when every block is run-length coded. */
+#define BLOCKRLE 0x10
+
+/** All transform flags. */
+#define BLOCKTRANSFORMS (BLOCKBWT | BLOCKMTF | BLOCKRLE)
+
+/** Number of streams a block is split into with BLOCKSPLIT. */
+#define BLOCKSTREAMS 4
+
+/** Number of input bytes in every block but the last. */
+#define BLOCKSIZE (1 << 20)
+
+/** Number of blocks handed to every thread per round. */
+#define BLOCKSPERTHREAD 4
+
+/**
+ * @struct BLOCKJOB
+ * @brief One block and its coded form.
+ */
+typedef struct BlockJob
+{
+    unsigned char *raw;       /**< Uncompressed bytes */
+    size_t rawLen;            /**< Number of uncompressed bytes */
+    unsigned char *coded;     /**< Compressed bytes */
+    size_t codedLen;          /**< Number of compressed bytes */
+    size_t codedCap;          /**< Bytes allocated for coded */
+    unsigned char *work;      /**< Transformed bytes, NULL until a transform runs */
+    size_t workCap;           /**< Bytes allocated for work */
+    unsigned char *ready;     /**< Transformed bytes kept from the counting pass, NULL if none */
+    size_t readyLen;          /**< Number of bytes in ready */
+    uint32_t primary;         /**< BWT primary row of ready */
+    HUFFTREE tree;            /**< Tree reused by the per-block tables of this job */
+    uint64_t payload;         /**< Bits of codes in coded, for statCoding */
+    uint64_t counts[SYMBOLS]; /**< Byte counts of the block */
+} BLOCKJOB;
+
+/**
+ * @brief Encodes one block into job->coded.
+ *
+ * Without a code table, the block gets its own table built from its byte
+ * counts, and its 256 code lengths are written before the bitstream. If
+ * job->ready is set, the block was already transformed and those bytes are
+ * coded instead of transforming raw again.
+ *
+ * @param job Block with raw and rawLen set; coded is replaced.
+ * @param len Code lengths of a shared table, or NULL.
+ * @param bits Canonical codes of the shared table, or NULL.
+ * @param streams 1, or BLOCKSTREAMS to split the block (see BLOCKSPLIT).
+ * @param maxLen Longest allowed code length of a table of its own, 0 for
+ *               no limit.
+ * @param transforms Transforms to apply first, a combination of BLOCKBWT,
+ *                   BLOCKMTF and BLOCKRLE.
+ * @return void
+ */
+void encodeBlock(BLOCKJOB *, int *, uint64_t *, int, int, int);
+
+/**
+ * @brief Decodes job->coded into job->rawLen bytes of job->raw.
+ *
+ * @param job Block with coded, codedLen, raw and rawLen set.
+ * @param dt Decoding table of a shared table, or NULL if the block starts
+ *           with its own code lengths.
+ * @param streams 1, or BLOCKSTREAMS if the block is split.
+ * @param transforms Transforms the block was encoded with.
+ * @return 0 on success, -1 if the block is corrupted.
+ */
+int decodeBlock(BLOCKJOB *, DECODETABLE *, int, int);
+
+/**
+ * @brief Compresses a file into the block format with a thread pool.
+ *
+ * @param input Input file name.
+ * @param output Block output file name.
+ * @param threads Number of threads, 0 for one per CPU.
+ * @param global 1 to code all blocks with one table built from the whole
+ *               input, 0 to give every block its own table.
+ * @param split 1 to split every block into BLOCKSTREAMS streams.
+ * @param maxLen Longest allowed code length, 0 for no limit.
+ * @param transforms Transforms to apply to every block, a combination of
+ *                   BLOCKBWT, BLOCKMTF and BLOCKRLE.
+ * @return void
+ */
+void compressBlocks(char *, char *, int, int, int, int, int);
+
+/**
+ * @brief Decompresses a block file with a thread pool.
+ *
+ * @param input Block input file name.
+ * @param output Decompressed output file name.
+ * @param threads Number of threads, 0 for one per CPU.
+ * @return void
+ */
+void decompBlocks(char *, char *, int);
+
+#endif
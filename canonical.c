@@ -0,0 +1,175 @@
+#include "canonical.h"
+
+static void leafDepths(TREENODE *nodes, int node, int depth, int *len)
+{
+    TREENODE *t = &nodes[node];
+    if (t->left == NONODE && t->right == NONODE)
+    {
+        if (t->c >= 0 && t->c < MAXSYMBOLS)
+            len[t->c] = depth == 0 ? 1 : depth;
+        return;
+    }
+    if (depth >= MAXCODELEN)
+    {
+        printf("Error: Huffman tree is deeper than %d levels\n", MAXCODELEN);
+        exit(EXIT_FAILURE);
+    }
+    if (t->left != NONODE)
+        leafDepths(nodes, t->left, depth + 1, len);
+    if (t->right != NONODE)
+        leafDepths(nodes, t->right, depth + 1, len);
+}
+
+void codeLengths(HUFFTREE *ht, int *len)
+{
+    for (int i = 0; i < MAXSYMBOLS; i++)
+        len[i] = 0;
+    if (ht->root >= 0)
+        leafDepths(ht->nodes, ht->root, 0, len);
+}
+
+int canonicalCodes(int *len, uint64_t *bits, int n)
+{
+    uint64_t count[MAXCODELEN + 1];
+    uint64_t next[MAXCODELEN + 1];
+    for (int l = 0; l <= MAXCODELEN; l++)
+        count[l] = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (len[i] < 0 || len[i] > MAXCODELEN)
+            return -1;
+        count[len[i]]++;
+    }
+    count[0] = 0;
+    // Kraft inequality: every length must still have room for its codes
+    uint64_t space = 1;
+    for (int l = 1; l <= MAXCODELEN; l++)
+    {
+        space *= 2;
+        if (space < count[l])
+            return -1;
+        space -= count[l];
+        if (space > (uint64_t)n)
+            space = (uint64_t)n;
+    }
+    uint64_t code = 0;
+    next[0] = 0;
+    for (int l = 1; l <= MAXCODELEN; l++)
+    {
+        code = (code + count[l - 1]) << 1;
+        next[l] = code;
+    }
+    for (int i = 0; i < n; i++)
+        bits[i] = len[i] == 0 ? 0 : next[len[i]]++;
+    return 0;
+}
+
+int limitLengths(uint64_t *counts, int *len, int n, int maxLen)
+{
+    // Characters with a code, sorted by count (insertion sort, n is small)
+    int sym[MAXSYMBOLS];
+    int m = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (len[i] == 0)
+            continue;
+        int j = m++;
+        while (j > 0 && counts[sym[j - 1]] > counts[i])
+        {
+            sym[j] = sym[j - 1];
+            j--;
+        }
+        sym[j] = i;
+    }
+    if (m <= 2)
+        return 0; // lengths of 1 can't be shortened
+    if (maxLen >= MAXCODELEN || (maxLen < 31 && ((uint64_t)1 << maxLen) < (uint64_t)m))
+        return maxLen >= MAXCODELEN ? 0 : -1;
+    // Package-merge: the list of level l merges the characters with the
+    // pairs of items of level l + 1; only whether an item is a character
+    // needs to be kept to count the code lengths afterwards
+    unsigned char leaf[MAXCODELEN][2 * MAXSYMBOLS];
+    int size[MAXCODELEN];
+    uint64_t weight[2 * MAXSYMBOLS];
+    uint64_t merged[2 * MAXSYMBOLS];
+    int prev = 0;
+    for (int l = maxLen - 1; l >= 0; l--)
+    {
+        int packages = prev / 2;
+        int i = 0, p = 0, k = 0;
+        while (i < m || p < packages)
+        {
+            uint64_t pw = p < packages ? weight[2 * p] + weight[2 * p + 1] : 0;
+            if (i < m && (p == packages || counts[sym[i]] <= pw))
+            {
+                merged[k] = counts[sym[i++]];
+                leaf[l][k++] = 1;
+            }
+            else
+            {
+                merged[k] = pw;
+                leaf[l][k++] = 0;
+                p++;
+            }
+        }
+        size[l] = k;
+        memcpy(weight, merged, k * sizeof(uint64_t));
+        prev = k;
+    }
+    // The first 2m - 2 items of the top list make up the optimal code; every
+    // character gets one bit for each list it is chosen from
+    for (int i = 0; i < m; i++)
+        len[sym[i]] = 0;
+    int take = 2 * m - 2;
+    for (int l = 0; l < maxLen && take > 0; l++)
+    {
+        int leaves = 0;
+        for (int k = 0; k < take && k < size[l]; k++)
+            leaves += leaf[l][k];
+        for (int i = 0; i < leaves; i++)
+            len[sym[i]]++;
+        take = 2 * (take - leaves);
+    }
+    return 0;
+}
+
+uint64_t codeBits(uint64_t *counts, int *len, int n)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < n; i++)
+        total += counts[i] * (uint64_t)len[i];
+    return total;
+}
+
+int encodeTable(CODEENTRY *table, int *len, uint64_t *bits, int n)
+{
+    int maxLen = 0;
+    for (int i = 0; i < n; i++)
+    {
+        table[i].bits = len[i] > 0 ? bits[i] : 0;
+        table[i].len = len[i];
+        if (len[i] > maxLen)
+            maxLen = len[i];
+    }
+    return maxLen;
+}
+
+void codeStrings(int *len, uint64_t *bits, char **codes, int n, HUFFTREE *ht)
+{
+    size_t total = 0;
+    for (int i = 0; i < n; i++)
+        if (len[i] > 0)
+            total += len[i] + 1;
+    char *next = treeText(ht, total);
+    for (int i = 0; i < n; i++)
+    {
+        codes[i] = NULL;
+        if (len[i] == 0)
+            continue;
+        codes[i] = next;
+        next += len[i] + 1;
+        for (int j = 0; j < len[i]; j++)
+            codes[i][j] = (char)('0' + ((bits[i] >> (len[i] - 1 - j)) & 1));
+        codes[i][len[i]] = '\0';
+    }
+}
@@ -0,0 +1,102 @@
+/**
+ * @file canonical.h
+ * @brief Canonical Huffman code assignment.
+ *
+ * Only the code length of every character is taken from the Huffman tree.
+ * The codes themselves are assigned canonically: shorter codes come first
+ * and codes of the same length are consecutive numbers in character order.
+ * Because of that, the code lengths alone are enough to rebuild every code,
+ * so an encoded file only needs to carry one length byte per character and
+ * the decoder needs neither the tree nor the probability file.
+ *
+ * @see huffmanTree.h
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "huffmanTree.h"
+#include "bitio.h"
+
+#ifndef CANONICALH
+#define CANONICALH
+
+/** Longest supported code, in bits, so that every code fits in 64 bits. */
+#define MAXCODELEN 64
+
+/**
+ * @brief Finds the code length of every character from a Huffman tree.
+ *
+ * The code length of a character is the depth of its leaf. A tree with a
+ * single leaf gives it a length of 1. Characters without a leaf get 0.
+ *
+ * @param ht Huffman tree.
+ * @param len Array of MAXSYMBOLS to store the code lengths.
+ * @return void
+ */
+void codeLengths(HUFFTREE *, int *);
+
+/**
+ * @brief Assigns canonical codes from code lengths.
+ *
+ * @param len Code length of every character, 0 if it has no code.
+ * @param bits Array to store the code of every character, right-aligned.
+ * @param n Number of characters.
+ * @return 0 on success, -1 if the lengths do not describe a prefix code.
+ */
+int canonicalCodes(int *, uint64_t *, int);
+
+/**
+ * @brief Limits code lengths to a maximum with the package-merge algorithm.
+ *
+ * Replaces the lengths of the characters that have a code with the optimal
+ * lengths of at most maxLen bits for their counts, which is a bit worse than
+ * an unlimited Huffman code if some codes were longer. Short codes also keep
+ * the decoding tables small (see lookup.h): with at most LOOKUPBITS bits
+ * every character decodes from the first level table.
+ *
+ * @param counts Count of every character.
+ * @param len Code length of every character, 0 if it has no code.
+ * @param n Number of characters.
+ * @param maxLen Longest allowed code length.
+ * @return 0 on success, -1 if maxLen bits are too few for all the characters.
+ */
+int limitLengths(uint64_t *, int *, int, int);
+
+/**
+ * @brief Computes the size of a coded input.
+ *
+ * @param counts Count of every character.
+ * @param len Code length of every character.
+ * @param n Number of characters.
+ * @return Number of bits the characters take with these codes.
+ */
+uint64_t codeBits(uint64_t *, int *, int);
+
+/**
+ * @brief Collects code lengths and codes into a table for writeSymbols.
+ *
+ * @param table Array to store the code of every character.
+ * @param len Code length of every character, 0 if it has no code.
+ * @param bits Code of every character.
+ * @param n Number of characters.
+ * @return The longest code length.
+ */
+int encodeTable(CODEENTRY *, int *, uint64_t *, int);
+
+/**
+ * @brief Writes canonical codes as strings of '0' and '1'.
+ *
+ * This is the representation used by printFCode and printEncFile. All the
+ * strings are stored one after the other in the arena of a tree, after its
+ * nodes (see treeText), and are freed with it.
+ *
+ * @param len Code length of every character, 0 if it has no code.
+ * @param bits Code of every character.
+ * @param codes Array to store the strings, NULL for characters without a code.
+ * @param n Number of characters.
+ * @param ht Tree whose arena holds the strings.
+ * @return void
+ */
+void codeStrings(int *, uint64_t *, char **, int, HUFFTREE *);
+
+#endif
@@ -0,0 +1,129 @@
+#!/bin/sh
+# Round-trips every coding mode of the program on edge-case inputs and
+# compares the decoded output with the input byte for byte.
+#
+# Usage: check/check.sh ./huffman
+# Run by `make check`. Prints the first mode that fails and exits with 1,
+# or prints how many round trips passed.
+
+H=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+SRC=$(cd "$(dirname "$0")/.." && pwd)
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+cd "$DIR" || exit 1
+PASSED=0
+
+fail()
+{
+    echo "FAIL: $*"
+    exit 1
+}
+
+# Compares the expected file $1 with the decoded file $2
+same()
+{
+    cmp -s "$1" "$2" || fail "$3 differs from $1"
+    PASSED=$((PASSED + 1))
+}
+
+# Compresses $1 with the options $2 into $1.enc and decompresses it again
+roundtrip()
+{
+    rm -f "$1.enc" "$1.out"
+    $H $2 -c "$1" "$1.enc" > /dev/null || fail "$2 -c $1"
+    $H -x "$1.enc" "$1.out" > /dev/null || fail "-x $1 after $2 -c"
+    same "$1" "$1.out" "$2 -c"
+}
+
+# Inputs: empty, one byte, one symbol, text, binary, and text of exactly
+# one block and one byte more (BLOCKSIZE in block.h)
+: > empty.txt
+printf 'x' > one.txt
+i=0
+: > single.txt
+while [ $i -lt 100 ]; do
+    printf 'aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa' >> single.txt
+    i=$((i + 1))
+done
+cat "$SRC"/*.c "$SRC"/*.h "$SRC"/README.md > text.txt
+head -c 200000 "$H" > binary.txt
+: > many.txt
+while [ "$(wc -c < many.txt)" -le 1048576 ]; do
+    cat text.txt >> many.txt
+done
+head -c 1048576 many.txt > block.txt
+head -c 1048577 many.txt > block1.txt
+rm many.txt
+INPUTS="empty.txt one.txt single.txt text.txt binary.txt block.txt block1.txt"
+
+for f in $INPUTS; do
+    # -c/-x: packed, end-of-stream symbol, length limit, samples, index
+    roundtrip $f ""
+    roundtrip $f "-z"
+    roundtrip $f "-l 11"
+    roundtrip $f "-n 2"
+    roundtrip $f "-b 1"
+    # -j: block format with one table per block or a global one, split
+    # streams and transforms
+    roundtrip $f "-j 2"
+    roundtrip $f "-j 2 -g"
+    roundtrip $f "-j 2 -i"
+    roundtrip $f "-j 2 -g -i -l 12"
+    roundtrip $f "-j 2 -f rle"
+    roundtrip $f "-j 2 -f bwt,mtf,rle"
+    roundtrip $f "-j 2 -g -f bwt,mtf"
+    # -o: order-1 context
+    roundtrip $f "-o"
+
+    # Stream format through pipes
+    $H -c - - < $f | $H -x - - > $f.out || fail "-c - - $f"
+    same $f $f.out "-c - -"
+
+    # -a/-u: adaptive, updating the tree per byte or rebuilding the codes
+    rm -f $f.out
+    $H -a $f $f.enc > /dev/null && $H -u $f.enc $f.out > /dev/null || fail "-a $f"
+    same $f $f.out "-a"
+    $H -k 4 -a - - < $f | $H -u - - > $f.out || fail "-k 4 -a - - $f"
+    same $f $f.out "-k 4 -a"
+
+    # -r: ranges of a packed file with an index every KiB, TO is exclusive
+    # and capped at the length of the file
+    $H -b 1 -c $f $f.enc > /dev/null || fail "-b 1 -c $f"
+    n=$(wc -c < $f)
+    for r in 0:0 0:1 0:$n 1:$((n / 2)) $((n / 3)):$((n / 3 + 5000)) $((n / 2)):$((n + 100)); do
+        from=${r%:*}
+        to=${r#*:}
+        [ $from -le $to ] && [ $from -le $n ] || continue
+        [ $to -le $n ] || to=$n
+        rm -f $f.out
+        $H -r $r -x $f.enc $f.out > /dev/null || fail "-r $r -x $f"
+        tail -c +$((from + 1)) $f | head -c $((to - from)) > $f.part
+        same $f.part $f.out "-r $r"
+    done
+
+    # -e/-d with a probability file and with a compiled model (-m). The
+    # probability file has no codes for characters it hasn't seen, so it is
+    # made from the input itself.
+    [ -s $f ] || continue
+    cp $f long-named-copy-of-the-input-for-the-probability-file-$f
+    $H -p long-named-copy-of-the-input-for-the-probability-file-$f $f.probabilities.txt > /dev/null ||
+        fail "-p $f"
+    $H -e $f.probabilities.txt $f $f.enc > /dev/null && $H -d $f.probabilities.txt $f.enc $f.new > /dev/null ||
+        fail "-e/-d $f"
+    same $f $f.new "-e/-d"
+    $H -z -l 12 -e $f.probabilities.txt $f $f.enc > /dev/null &&
+        $H -z -l 12 -d $f.probabilities.txt $f.enc $f.new > /dev/null || fail "-z -l 12 -e/-d $f"
+    same $f $f.new "-z -l 12 -e/-d"
+    $H -m $f.probabilities.txt $f.compiled.model > /dev/null || fail "-m $f"
+    $H -e $f.compiled.model $f $f.enc > /dev/null && $H -d $f.compiled.model $f.enc $f.new > /dev/null ||
+        fail "-e/-d with a model $f"
+    same $f $f.new "-e/-d with a model"
+done
+
+# -t: the textual format, which needs at least two different characters
+$H -p long-named-copy-of-the-input-for-the-probability-file-text.txt text.txt.probabilities.txt > /dev/null
+$H -t -e text.txt.probabilities.txt text.txt text.txt.enc > /dev/null &&
+    $H -t -d text.txt.probabilities.txt text.txt.enc text.txt.new > /dev/null || fail "-t -e/-d text.txt"
+same text.txt text.txt.new "-t -e/-d"
+
+echo "All $PASSED round trips passed"
@@ -0,0 +1,350 @@
+#include "context.h"
+#include "lookup.h"
+#include "mapfile.h"
+#include "stats.h"
+
+// Size of the buffer decoded characters are collected in
+#define CONTEXTOUT (1 << 16)
+
+// Counts and code tables of the contexts while they are grouped
+typedef struct ContextModel
+{
+    uint64_t counts[CONTEXTS][MAXSYMBOLS]; // Byte counts of every context
+    uint64_t total[CONTEXTS];              // Number of bytes in every context
+    uint64_t sum[CONTEXTMAX][MAXSYMBOLS];  // Byte counts of every table
+    int len[CONTEXTMAX][MAXSYMBOLS];       // Code lengths of every table
+    CODEENTRY table[CONTEXTMAX][SYMBOLS];  // Codes of every table
+    unsigned char map[CONTEXTS];           // Table of every context
+    int tables;                            // Number of tables
+} CONTEXTMODEL;
+
+// Bits the counts of a context take with the given code lengths,
+// UINT64_MAX if one of its bytes has no code
+static uint64_t contextBits(const uint64_t *counts, const int *len)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < SYMBOLS; i++)
+    {
+        if (counts[i] > 0 && len[i] == 0)
+            return UINT64_MAX;
+        total += counts[i] * (uint64_t)len[i];
+    }
+    return total;
+}
+
+// Drops the tables without contexts and builds the code lengths of the
+// others from the counts of their contexts
+static void buildTables(CONTEXTMODEL *m, HUFFTREE *ht, int maxLen)
+{
+    int renum[CONTEXTMAX];
+    for (int t = 0; t < CONTEXTMAX; t++)
+        renum[t] = -1;
+    int k = 0;
+    for (int c = 0; c < CONTEXTS; c++)
+        if (m->total[c] > 0 && renum[m->map[c]] == -1)
+            renum[m->map[c]] = k++;
+    for (int t = 0; t < k; t++)
+        for (int i = 0; i < MAXSYMBOLS; i++)
+            m->sum[t][i] = 0;
+    for (int c = 0; c < CONTEXTS; c++)
+    {
+        // Contexts that never occur are never looked up
+        m->map[c] = m->total[c] > 0 ? (unsigned char)renum[m->map[c]] : 0;
+        if (m->total[c] > 0)
+            for (int i = 0; i < SYMBOLS; i++)
+                m->sum[m->map[c]][i] += m->counts[c][i];
+    }
+    for (int t = 0; t < k; t++)
+        huffmanLengths(m->sum[t], m->len[t], ht, maxLen);
+    m->tables = k;
+}
+
+// Groups the contexts into at most CONTEXTMAX tables, see context.h
+static void groupContexts(CONTEXTMODEL *m, int maxLen)
+{
+    HUFFTREE ht = {NULL, 0, -1, 0, NULL};
+    // Order-0 codes, which every context is first compared to
+    for (int c = 0; c < CONTEXTS; c++)
+        m->map[c] = 0;
+    buildTables(m, &ht, maxLen);
+    if (m->tables == 0)
+    {
+        freeTree(&ht);
+        return;
+    }
+    int order0[MAXSYMBOLS];
+    memcpy(order0, m->len[0], sizeof(order0));
+    // Most frequent contexts first
+    int byTotal[CONTEXTS];
+    for (int c = 0; c < CONTEXTS; c++)
+    {
+        int j = c;
+        for (; j > 0 && m->total[byTotal[j - 1]] < m->total[c]; j--)
+            byTotal[j] = byTotal[j - 1];
+        byTotal[j] = c;
+    }
+    int own[MAXSYMBOLS];
+    int k = 1;
+    for (int j = 0; j < CONTEXTS && k < CONTEXTMAX && m->total[byTotal[j]] > 0; j++)
+    {
+        int c = byTotal[j];
+        m->map[c] = 0;
+        huffmanLengths(m->counts[c], own, &ht, maxLen);
+        if (contextBits(m->counts[c], own) + CONTEXTHEADER < contextBits(m->counts[c], order0))
+            m->map[c] = (unsigned char)k++;
+    }
+    for (int pass = 0; pass < CONTEXTPASSES; pass++)
+    {
+        buildTables(m, &ht, maxLen);
+        int moved = 0;
+        for (int c = 0; c < CONTEXTS; c++)
+        {
+            if (m->total[c] == 0)
+                continue;
+            int best = m->map[c];
+            uint64_t bestBits = contextBits(m->counts[c], m->len[best]);
+            for (int t = 0; t < m->tables; t++)
+            {
+                uint64_t bits = contextBits(m->counts[c], m->len[t]);
+                if (bits < bestBits)
+                {
+                    best = t;
+                    bestBits = bits;
+                }
+            }
+            moved |= best != m->map[c];
+            m->map[c] = (unsigned char)best;
+        }
+        if (!moved)
+            break;
+    }
+    buildTables(m, &ht, maxLen);
+    freeTree(&ht);
+}
+
+void compressContext(char *input, char *output, int maxLen)
+{
+    double timer = STATBEGIN();
+    CONTEXTMODEL *m = (CONTEXTMODEL *)calloc(1, sizeof(CONTEXTMODEL));
+    if (m == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    INPUTFILE in;
+    if (openInput(&in, input) == -1)
+    {
+        perror("Error opening input file");
+        exit(EXIT_FAILURE);
+    }
+    const unsigned char *chunk;
+    size_t k;
+    uint64_t n = 0;
+    int prev = 0;
+    while ((k = nextInput(&in, &chunk)) > 0)
+    {
+        for (size_t i = 0; i < k; i++)
+        {
+            m->counts[prev][chunk[i]]++;
+            prev = chunk[i];
+        }
+        n += k;
+    }
+    if (rewindInput(&in) == -1)
+    {
+        printf("Error: %s can't be read twice\n", input);
+        exit(EXIT_FAILURE);
+    }
+    for (int c = 0; c < CONTEXTS; c++)
+        for (int i = 0; i < SYMBOLS; i++)
+            m->total[c] += m->counts[c][i];
+    groupContexts(m, maxLen);
+    FILE *fp2 = fopen(output, "wb");
+    if (fp2 == NULL)
+    {
+        perror("Error opening output file");
+        closeInput(&in);
+        exit(EXIT_FAILURE);
+    }
+    fwrite(CONTEXTMAGIC, 1, 4, fp2);
+    fputc(CONTEXTVERSION, fp2);
+    writeU64(fp2, n);
+    fputc(m->tables, fp2);
+    fwrite(m->map, 1, CONTEXTS, fp2);
+    const CODEENTRY *ctx[CONTEXTS];
+    int longest = 0;
+    for (int t = 0; t < m->tables; t++)
+    {
+        uint64_t bits[MAXSYMBOLS];
+        for (int i = 0; i < SYMBOLS; i++)
+            fputc(m->len[t][i], fp2);
+        canonicalCodes(m->len[t], bits, MAXSYMBOLS);
+        int l = encodeTable(m->table[t], m->len[t], bits, SYMBOLS);
+        if (l > longest)
+            longest = l;
+    }
+    for (int c = 0; c < CONTEXTS; c++)
+        ctx[c] = m->table[m->map[c]];
+    BITWRITER bw;
+    openWriter(&bw, fp2);
+    int missing = 0;
+    prev = 0;
+    while (m->tables > 0 && (k = nextInput(&in, &chunk)) > 0)
+    {
+        size_t i = 0;
+        if (longest <= 16)
+        {
+            // Four codes fit in one write
+            for (; i + 4 <= k; i += 4)
+            {
+                const CODEENTRY *a = &ctx[prev][chunk[i]];
+                const CODEENTRY *b = &ctx[chunk[i]][chunk[i + 1]];
+                const CODEENTRY *c = &ctx[chunk[i + 1]][chunk[i + 2]];
+                const CODEENTRY *d = &ctx[chunk[i + 2]][chunk[i + 3]];
+                uint64_t group = a->bits;
+                group = (group << b->len) | b->bits;
+                group = (group << c->len) | c->bits;
+                group = (group << d->len) | d->bits;
+                missing |= (a->len == 0) | (b->len == 0) | (c->len == 0) | (d->len == 0);
+                writeBits(&bw, group, a->len + b->len + c->len + d->len);
+                prev = chunk[i + 3];
+            }
+        }
+        for (; i < k; i++)
+        {
+            const CODEENTRY *e = &ctx[prev][chunk[i]];
+            writeBits(&bw, e->bits, e->len);
+            missing |= e->len == 0;
+            prev = chunk[i];
+        }
+    }
+    if (missing)
+    {
+        printf("Error: %s changed while it was compressed\n", input);
+        exit(EXIT_FAILURE);
+    }
+    STATPAYLOAD(bw.bits);
+    closeWriter(&bw);
+    closeInput(&in);
+    free(m);
+    if (fclose(fp2) != 0)
+    {
+        perror("Error writing output file");
+        exit(EXIT_FAILURE);
+    }
+    STATEND(STATENCODE, timer, n);
+}
+
+void decompContext(char *input, char *output)
+{
+    double timer = STATBEGIN();
+    FILE *fp1 = fopen(input, "rb");
+    if (fp1 == NULL)
+    {
+        perror("Error opening input file");
+        exit(EXIT_FAILURE);
+    }
+    char magic[4];
+    if (fread(magic, 1, 4, fp1) != 4 || memcmp(magic, CONTEXTMAGIC, 4) != 0 || fgetc(fp1) != CONTEXTVERSION)
+    {
+        printf("Error: %s is not a context file\n", input);
+        fclose(fp1);
+        exit(EXIT_FAILURE);
+    }
+    uint64_t n = readU64(fp1);
+    int tables = fgetc(fp1);
+    unsigned char map[CONTEXTS];
+    if (tables == EOF || tables > CONTEXTMAX || (tables == 0 && n > 0) || fread(map, 1, CONTEXTS, fp1) != CONTEXTS)
+    {
+        printf("Error: Context file header is corrupted\n");
+        exit(EXIT_FAILURE);
+    }
+    DECODETABLE dt[CONTEXTMAX];
+    for (int t = 0; t < tables; t++)
+    {
+        int len[MAXSYMBOLS];
+        len[EOS] = 0;
+        for (int i = 0; i < SYMBOLS; i++)
+            len[i] = fgetc(fp1);
+        if (len[SYMBOLS - 1] == EOF || tableFromLengths(&dt[t], len, MAXSYMBOLS) == -1)
+        {
+            printf("Error: Context file header is corrupted\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    DECODETABLE *ctx[CONTEXTS];
+    for (int c = 0; c < CONTEXTS; c++)
+    {
+        if (map[c] >= tables && n > 0)
+        {
+            printf("Error: Context file header is corrupted\n");
+            exit(EXIT_FAILURE);
+        }
+        ctx[c] = &dt[map[c]];
+    }
+    FILE *fp2 = fopen(output, "wb");
+    if (fp2 == NULL)
+    {
+        perror("Error opening output file");
+        fclose(fp1);
+        exit(EXIT_FAILURE);
+    }
+    // The bitstream is decoded straight from the mapped file if possible
+    long start = ftell(fp1);
+    INPUTFILE in;
+    const unsigned char *data = NULL;
+    size_t size = 0;
+    int mapped = 0;
+    if (openInput(&in, input) == 0)
+    {
+        mapped = in.mapped;
+        if (mapped)
+            size = nextInput(&in, &data);
+        else
+            closeInput(&in);
+    }
+    BITREADER br;
+    if (mapped && start >= 0 && (size_t)start <= size)
+        openBufferReader(&br, data + start, size - start);
+    else
+        openReader(&br, fp1);
+    unsigned char *buf = (unsigned char *)malloc(CONTEXTOUT);
+    if (buf == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    size_t used = 0;
+    int prev = 0;
+    for (uint64_t k = 0; k < n; k++)
+    {
+        int c = decodeSymbol(ctx[prev], &br);
+        if (c < 0 || c >= SYMBOLS)
+        {
+            printf("Error: %s is truncated or corrupted\n", input);
+            exit(EXIT_FAILURE);
+        }
+        buf[used++] = (unsigned char)c;
+        if (used == CONTEXTOUT)
+        {
+            fwrite(buf, 1, used, fp2);
+            used = 0;
+        }
+        prev = c;
+    }
+    fwrite(buf, 1, used, fp2);
+    for (int t = 0; t < tables; t++)
+        freeTable(&dt[t]);
+    STATPAYLOAD(bitsRead(&br));
+    closeReader(&br);
+    if (mapped)
+        closeInput(&in);
+    free(buf);
+    fclose(fp1);
+    if (fclose(fp2) != 0)
+    {
+        perror("Error writing output file");
+        exit(EXIT_FAILURE);
+    }
+    STATEND(STATDECODE, timer, n);
+}
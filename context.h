@@ -0,0 +1,82 @@
+/**
+ * @file context.h
+ * @brief Order-1 context modeled Huffman coding.
+ *
+ * The packed format codes every byte with the same table, but in structured
+ * text the next byte depends heavily on the one before it. The context
+ * format picks the code table of every byte by the byte before it (its
+ * context). Contexts whose bytes are distributed alike share a table, so
+ * the header stays small:
+ *
+ * - every context that is frequent enough for its own table to pay for the
+ *   CONTEXTHEADER bits it adds to the header gets one, up to CONTEXTMAX,
+ * - all other contexts share one table,
+ * - then CONTEXTPASSES times, every context moves to the table that codes
+ *   its bytes in the fewest bits and the tables are rebuilt from the
+ *   contexts they got. Tables that lose all their contexts are dropped.
+ *
+ * A context file consists of:
+ *
+ * - a 4 byte magic "HUFC" and a 1 byte format version,
+ * - the original length in bytes as a 64-bit big-endian integer,
+ * - a 1 byte number of tables,
+ * - 256 bytes with the table of every context,
+ * - 256 bytes with the code lengths of every table,
+ * - the bitstream: the canonical code of every byte from the table of the
+ *   byte before it, packed MSB-first into 64-bit words. The first byte is
+ *   coded in the context of byte 0.
+ *
+ * Encoding and decoding stay table-driven (see bitio.h and lookup.h), they
+ * only switch tables between bytes.
+ *
+ * @see packed.h
+ * @see lookup.h
+ */
+
+#include "bitio.h"
+#include "canonical.h"
+
+#ifndef CONTEXTH
+#define CONTEXTH
+
+/** Magic bytes at the start of every context file. */
+#define CONTEXTMAGIC "HUFC"
+
+/** Current version of the context format. */
+#define CONTEXTVERSION 1
+
+/** Number of contexts, one per preceding byte value. */
+#define CONTEXTS 256
+
+/** Largest number of code tables in a file. */
+#define CONTEXTMAX 32
+
+/** Bits a code table adds to the header. */
+#define CONTEXTHEADER (SYMBOLS * 8)
+
+/** Number of times the contexts are moved between the tables. */
+#define CONTEXTPASSES 4
+
+/**
+ * @brief Compresses a file with order-1 context modeled codes.
+ *
+ * Counts the bytes of the input per context, groups the contexts into
+ * tables, builds the codes of every table and writes a context file.
+ *
+ * @param input Input file name.
+ * @param output Context output file name.
+ * @param maxLen Longest allowed code length, 0 for no limit.
+ * @return void
+ */
+void compressContext(char *, char *, int);
+
+/**
+ * @brief Decompresses a context file.
+ *
+ * @param input Context input file name.
+ * @param output Decompressed output file name.
+ * @return void
+ */
+void decompContext(char *, char *);
+
+#endif
@@ -0,0 +1,54 @@
+#include "cpu.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int features;
+static char names[32];
+static pthread_once_t probed = PTHREAD_ONCE_INIT;
+
+// The names HUFFMANCPU uses, in the order of the bits
+static const char *featureNames[] = {"sse4.2", "avx2", "bmi2"};
+
+static void probe(void)
+{
+#if CPUX86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+        features |= CPUSSE42;
+    if (__builtin_cpu_supports("avx2"))
+        features |= CPUAVX2;
+    if (__builtin_cpu_supports("bmi2"))
+        features |= CPUBMI2;
+#endif
+    const char *allowed = getenv("HUFFMANCPU");
+    if (allowed != NULL)
+    {
+        for (int i = 0; i < 3; i++)
+            if (strstr(allowed, featureNames[i]) == NULL)
+                features &= ~(1 << i);
+    }
+    names[0] = '\0';
+    for (int i = 0; i < 3; i++)
+    {
+        if ((features & (1 << i)) == 0)
+            continue;
+        if (names[0] != '\0')
+            strcat(names, ",");
+        strcat(names, featureNames[i]);
+    }
+    if (names[0] == '\0')
+        strcpy(names, "scalar");
+}
+
+int cpuFeatures(void)
+{
+    pthread_once(&probed, probe);
+    return features;
+}
+
+const char *cpuKernels(void)
+{
+    pthread_once(&probed, probe);
+    return names;
+}
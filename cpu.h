@@ -0,0 +1,83 @@
+/**
+ * @file cpu.h
+ * @brief Runtime selection of CPU specific kernels.
+ *
+ * The hot loops (counting bytes, packing codes and decoding streams) are
+ * compiled several times for different instruction sets with GCC's target
+ * attribute, so the makefile needs no -m flags and one binary runs on any
+ * x86-64 machine. The features of the CPU are probed once with cpuid at
+ * startup, when every module points its kernels at the best version the CPU
+ * supports, so a call costs no more than an indirect call:
+ *
+ * - CPUSSE42: SSE4.2, merging the counter arrays of a histogram 2 at a time,
+ * - CPUAVX2: AVX2, merging them 4 at a time,
+ * - CPUBMI2: BMI2. The bit writer and the decoder are the portable C loops
+ *   compiled for BMI2, so the compiler can use shlx/shrx/bzhi for their
+ *   variable shifts and masks; they have no hand written intrinsics.
+ *
+ * The environment variable HUFFMANCPU limits the features that are used to
+ * a comma separated list, e.g. HUFFMANCPU=sse4.2 or HUFFMANCPU=scalar for
+ * none, to compare the kernels. On other compilers and architectures only
+ * the portable kernels are built.
+ *
+ * @see histogram.h
+ * @see bitio.h
+ * @see lookup.h
+ */
+
+#ifndef CPUH
+#define CPUH
+
+/** SSE4.2 is supported. */
+#define CPUSSE42 0x01
+
+/** AVX2 is supported. */
+#define CPUAVX2 0x02
+
+/** BMI2 is supported. */
+#define CPUBMI2 0x04
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+/** 1 if the kernels for x86 instruction sets are built. */
+#define CPUX86 1
+/** Compiles a function for an instruction set, e.g. KERNEL("avx2"). */
+#define KERNEL(isa) __attribute__((target(isa)))
+/** Runs a function once before main, to pick the kernels of a module. */
+#define KERNELSELECT __attribute__((constructor))
+#else
+#define CPUX86 0
+#define KERNEL(isa)
+#endif
+
+#if defined(__GNUC__)
+/** Body of a kernel, inlined into every version so each is compiled for its instruction set. */
+#define KERNELBODY static inline __attribute__((always_inline))
+#else
+#define KERNELBODY static inline
+#endif
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/** Converts a native word to big-endian and back, defined where it is one instruction. */
+#define WORDBE(w) __builtin_bswap64(w)
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define WORDBE(w) (w)
+#endif
+
+/**
+ * @brief Returns the features of the CPU the kernels may use.
+ *
+ * The CPU is probed on the first call, from any thread. The modules call it
+ * once before main to pick their kernels, not on every call.
+ *
+ * @return Combination of CPUSSE42, CPUAVX2 and CPUBMI2.
+ */
+int cpuFeatures(void);
+
+/**
+ * @brief Names the features the kernels use, for reports.
+ *
+ * @return E.g. "sse4.2,avx2,bmi2", or "scalar" if none.
+ */
+const char *cpuKernels(void);
+
+#endif
@@ -0,0 +1,136 @@
+#include "histogram.h"
+#include "cpu.h"
+#if CPUX86
+#include <immintrin.h>
+#endif
+
+// Largest run counted into the 32-bit tables before they are merged
+#define HISTRUN ((size_t)1 << 30)
+
+static void mergeTables(uint32_t (*t)[SYMBOLS], uint64_t *counts)
+{
+    for (int k = 0; k < HISTTABLES; k++)
+        for (int s = 0; s < SYMBOLS; s++)
+            counts[s] += t[k][s];
+}
+
+#if CPUX86
+// Widens 2 counters at a time to 64 bits
+KERNEL("sse4.2") static void mergeSSE42(uint32_t (*t)[SYMBOLS], uint64_t *counts)
+{
+    for (int s = 0; s < SYMBOLS; s += 2)
+    {
+        __m128i sum = _mm_loadu_si128((const __m128i *)(counts + s));
+        for (int k = 0; k < HISTTABLES; k++)
+            sum = _mm_add_epi64(sum, _mm_cvtepu32_epi64(_mm_loadl_epi64((const __m128i *)(t[k] + s))));
+        _mm_storeu_si128((__m128i *)(counts + s), sum);
+    }
+}
+
+// Widens 4 counters at a time to 64 bits
+KERNEL("avx2") static void mergeAVX2(uint32_t (*t)[SYMBOLS], uint64_t *counts)
+{
+    for (int s = 0; s < SYMBOLS; s += 4)
+    {
+        __m256i sum = _mm256_loadu_si256((const __m256i *)(counts + s));
+        for (int k = 0; k < HISTTABLES; k++)
+            sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)(t[k] + s))));
+        _mm256_storeu_si256((__m256i *)(counts + s), sum);
+    }
+}
+#endif
+
+// The merge the CPU supports, picked once before main
+static void (*mergeBest)(uint32_t (*)[SYMBOLS], uint64_t *) = mergeTables;
+
+#if CPUX86
+KERNELSELECT static void selectMerge(void)
+{
+    int cpu = cpuFeatures();
+    if (cpu & CPUAVX2)
+        mergeBest = mergeAVX2;
+    else if (cpu & CPUSSE42)
+        mergeBest = mergeSSE42;
+}
+#endif
+
+void countBuffer(const unsigned char *buf, size_t n, uint64_t *counts)
+{
+    uint32_t t[HISTTABLES][SYMBOLS];
+    size_t i = 0;
+    while (i < n)
+    {
+        size_t end = n - i > HISTRUN ? i + HISTRUN : n;
+        memset(t, 0, sizeof(t));
+        for (; i + 8 <= end; i += 8)
+        {
+            uint64_t w;
+            memcpy(&w, buf + i, 8);
+            t[0][w & 0xff]++;
+            t[1][(w >> 8) & 0xff]++;
+            t[2][(w >> 16) & 0xff]++;
+            t[3][(w >> 24) & 0xff]++;
+            t[0][(w >> 32) & 0xff]++;
+            t[1][(w >> 40) & 0xff]++;
+            t[2][(w >> 48) & 0xff]++;
+            t[3][w >> 56]++;
+        }
+        for (; i < end; i++)
+            t[0][buf[i]]++;
+        mergeBest(t, counts);
+    }
+}
+
+long long histFile(char *filename, uint64_t *counts)
+{
+    INPUTFILE in;
+    if (openInput(&in, filename) == -1)
+        return -1;
+    long long total = 0;
+    const unsigned char *chunk;
+    size_t n;
+    while ((n = nextInput(&in, &chunk)) > 0)
+    {
+        countBuffer(chunk, n, counts);
+        total += (long long)n;
+    }
+    closeInput(&in);
+    return total;
+}
+
+long long sampleFile(char *filename, uint64_t *counts, int blocks, long long *sampled)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL)
+        return -1;
+    fseek(fp, 0, SEEK_END);
+    long long size = ftell(fp);
+    *sampled = 0;
+    if (size <= (long long)blocks * SAMPLEBLOCK)
+    {
+        // The samples would cover the whole file anyway
+        fclose(fp);
+        *sampled = histFile(filename, counts);
+        return *sampled;
+    }
+    unsigned char *buf = (unsigned char *)malloc(SAMPLEBLOCK);
+    if (buf == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    // The first block is at the start and the last one at the end
+    for (int b = 0; b < blocks; b++)
+    {
+        long long offset = blocks == 1 ? 0 : (size - SAMPLEBLOCK) / (blocks - 1) * b;
+        fseek(fp, (long)offset, SEEK_SET);
+        size_t n = fread(buf, 1, SAMPLEBLOCK, fp);
+        countBuffer(buf, n, counts);
+        *sampled += (long long)n;
+    }
+    free(buf);
+    fclose(fp);
+    for (int i = 0; i < SYMBOLS; i++)
+        counts[i]++;
+    return size;
+}
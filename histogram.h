@@ -0,0 +1,65 @@
+/**
+ * @file histogram.h
+ * @brief Integer byte histograms.
+ *
+ * Counts how many times every byte value appears in a buffer or a file with
+ * 64-bit integer counters, so the counts stay exact on inputs of any size.
+ * The counting loop spreads consecutive bytes over HISTTABLES interleaved
+ * counter arrays, so runs of the same byte don't stall on incrementing the
+ * same counter, and files are counted straight from their mapping (see
+ * mapfile.h).
+ *
+ * @see huffmanTree.h
+ * @see mapfile.h
+ */
+
+#include <stdint.h>
+#include "huffmanTree.h"
+#include "mapfile.h"
+
+#ifndef HISTOGRAMH
+#define HISTOGRAMH
+
+/** Size in bytes of the blocks sampleFile counts. */
+#define SAMPLEBLOCK (1 << 16)
+
+/** Number of interleaved counter arrays used by the counting loop (unrolled for 4). */
+#define HISTTABLES 4
+
+/**
+ * @brief Adds the byte counts of a buffer to a histogram.
+ *
+ * @param buf Buffer to count.
+ * @param n Number of bytes in the buffer.
+ * @param counts Array of SYMBOLS counters to add to.
+ * @return void
+ */
+void countBuffer(const unsigned char *, size_t, uint64_t *);
+
+/**
+ * @brief Adds the byte counts of a file to a histogram.
+ *
+ * @param filename Input file.
+ * @param counts Array of SYMBOLS counters to add to.
+ * @return The total number of bytes read, -1 if the file can't be opened.
+ */
+long long histFile(char *, uint64_t *);
+
+/**
+ * @brief Estimates the byte counts of a file from evenly spaced samples.
+ *
+ * Counts `blocks` blocks of SAMPLEBLOCK bytes spread evenly over the file,
+ * the first at its start and the last at its end, and then adds 1 to the
+ * count of every byte value, so bytes the samples missed still get a code.
+ * If the blocks would cover the whole file, it is counted exactly instead,
+ * without the added counts.
+ *
+ * @param filename Input file.
+ * @param counts Array of SYMBOLS counters to add to.
+ * @param blocks Number of blocks to sample, at least 1.
+ * @param sampled Pointer to store the number of bytes counted.
+ * @return The size of the file, -1 if it can't be opened.
+ */
+long long sampleFile(char *, uint64_t *, int, long long *);
+
+#endif
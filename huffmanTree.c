@@ -1,147 +1,174 @@
 #include "huffmanTree.h"
+#include "canonical.h"
+#include "histogram.h"
+#include "lookup.h"
+#include "stats.h"
 
-void probFile(char *filename, char *filenameOut, float *f)
+void addEOS(float *f)
 {
-    int count = readFile(filename, f);
-    if (count == -1)
-    {
-        printf("Error reading file: %s\n", filename);
-        exit(EXIT_FAILURE);
-    }
-    for (int i = 0; i < 128; i++)
-        f[i] = f[i] / count;
-    printF(f, filenameOut, 128);
-}
-
-TREENODE *createNode(float data, int c, TREENODE *l, TREENODE *r)
-{
-    TREENODE *t = (TREENODE *)malloc(sizeof(TREENODE));
-    if (t == NULL)
-    {
-        perror("Memory allocation failed");
-        exit(EXIT_FAILURE);
-    }
-    t->left = l;
-    t->right = r;
-    t->data = data;
-    t->c = c;
-    return t;
+    float min = 1;
+    for (int i = 0; i < SYMBOLS; i++)
+        if (f[i] > 0.0 && f[i] < min)
+            min = f[i];
+    f[EOS] = min;
 }
 
 int findCount(float *f)
 {
     int count = 0;
-    for (int i = 0; i < 128; i++)
+    for (int i = 0; i < MAXSYMBOLS; i++)
         if (f[i] > 0.0)
             count++;
     return count;
 }
 
-int huffmanT(float *f, char **codes, TREENODE **t)
+// The node that leaves the heap first: smaller frequency, then lower index
+static int lessNode(TREENODE *nodes, int a, int b)
 {
-    for (int i = 0; i < 128; i++)
-        *(t + i) = createNode(f[i], i, NULL, NULL);
-    int count = findCount(f);
-    createTree(&count, t);
-    for (int i = 0; i < 128; i++)
-    {
-        if (t[i] != NULL && t[i]->data > 0.0)
-            count = i;
-    }
-    int *arr = (int *)malloc(128 * sizeof(int));
-    createArray(t[count], arr, 0, codes);
-    free(arr);
-    // print codes
-    for (int i = 32; i < 127; i++)
+    if (nodes[a].data != nodes[b].data)
+        return nodes[a].data < nodes[b].data;
+    return a < b;
+}
+
+static void pushHeap(TREENODE *nodes, int *heap, int *hn, int x)
+{
+    int i = (*hn)++;
+    while (i > 0 && lessNode(nodes, x, heap[(i - 1) / 2]))
     {
-        printf("%c :", (char)i);
-        if (codes[i] == NULL)
-            printf("No code\n");
-        else
-            printf("%s\n", codes[i]);
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
     }
-    printFCode(codes, "codes.txt", 128);
-    return count;
+    heap[i] = x;
 }
 
-void findMin(TREENODE **t, int *c1, int *c2, int count)
+static int popHeap(TREENODE *nodes, int *heap, int *hn)
 {
-    float min1 = 1, min2 = 1;
-    for (int i = 0; i < 128; i++)
+    int top = heap[0];
+    int x = heap[--(*hn)];
+    int i = 0;
+    while (2 * i + 1 < *hn)
+    {
+        int child = 2 * i + 1;
+        if (child + 1 < *hn && lessNode(nodes, heap[child + 1], heap[child]))
+            child++;
+        if (!lessNode(nodes, heap[child], x))
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = x;
+    return top;
+}
+
+// Grows the arena of a tree to hold the nodes and text bytes after them
+static void growArena(HUFFTREE *ht, size_t text)
+{
+    size_t need = TREENODES * sizeof(TREENODE) + text;
+    if (ht->nodes == NULL || (size_t)ht->capacity < need)
     {
-        if (t[i] != NULL)
-            if (t[i]->data > 0.0)
-            {
-                if (t[i]->data < min1)
-                {
-                    min2 = min1;
-                    min1 = t[i]->data;
-                    *c2 = *c1;
-                    *c1 = i;
-                }
-                else if (t[i]->data < min2 && t[i]->data >= min1)
-                {
-                    min2 = t[i]->data;
-                    *c2 = i;
-                }
-            }
+        TREENODE *temp = (TREENODE *)realloc(ht->nodes, need);
+        if (temp == NULL)
+        {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        ht->nodes = temp;
+        ht->capacity = (int)need;
     }
+    ht->text = (char *)(ht->nodes + TREENODES);
 }
 
-void createTree(int *count, TREENODE **t)
+char *treeText(HUFFTREE *ht, size_t n)
 {
-    if (*count == 1)
-        return;
-    int min1, min2;
-    findMin(t, &min1, &min2, *count);
-    TREENODE *tempt = createNode(t[min1]->data + t[min2]->data, -1, t[min1], t[min2]);
-    removeNode(min1, min2, t, tempt);
-    (*count)--;
-    createTree(count, t);
+    growArena(ht, n);
+    return ht->text;
 }
 
-void createArray(TREENODE *t, int arr[], int top, char **codes)
+int buildTree(uint64_t *counts, HUFFTREE *ht, int n)
 {
-    if (t->left)
+    int heap[MAXSYMBOLS];
+    if (n > MAXSYMBOLS)
     {
-        arr[top] = 0;
-        createArray(t->left, arr, top + 1, codes);
+        printf("Error: A tree can have at most %d characters\n", MAXSYMBOLS);
+        exit(EXIT_FAILURE);
+    }
+    growArena(ht, 0);
+    TREENODE *nodes = ht->nodes;
+    int hn = 0;
+    ht->size = 0;
+    ht->root = -1;
+    for (int i = 0; i < n; i++)
+    {
+        if (counts[i] > 0)
+        {
+            nodes[ht->size].c = (int16_t)i;
+            nodes[ht->size].data = counts[i];
+            nodes[ht->size].left = NONODE;
+            nodes[ht->size].right = NONODE;
+            pushHeap(nodes, heap, &hn, ht->size++);
+        }
     }
-    if (t->right)
+    while (hn > 1)
     {
-        arr[top] = 1;
-        createArray(t->right, arr, top + 1, codes);
+        int min1 = popHeap(nodes, heap, &hn);
+        int min2 = popHeap(nodes, heap, &hn);
+        nodes[ht->size].c = -1;
+        nodes[ht->size].data = nodes[min1].data + nodes[min2].data;
+        nodes[ht->size].left = (uint16_t)min1;
+        nodes[ht->size].right = (uint16_t)min2;
+        pushHeap(nodes, heap, &hn, ht->size++);
     }
+    if (hn == 1)
+        ht->root = heap[0];
+    return ht->root;
+}
 
-    if (!(t->left) && !(t->right))
+void probWeights(float *f, uint64_t *w, int n)
+{
+    for (int i = 0; i < n; i++)
     {
-        if ((t->c) >= 0 && (t->c <= 127))
+        w[i] = 0;
+        if (f[i] > 0.0)
         {
-            // Allocate memory for the code
-            codes[t->c] = (char *)malloc((top + 1) * sizeof(char));
-            if (codes[t->c] == NULL)
-            {
-                perror("Memory allocation failed!\n");
-                exit(EXIT_FAILURE);
-            }
-
-            // Store the code in the array
-            for (int i = 0; i < top; i++)
-            {
-                codes[t->c][i] = (char)(arr[i] + '0');
-            }
-            codes[t->c][top] = '\0'; // Null-terminate the string
+            w[i] = (uint64_t)((double)f[i] * 4294967296.0 + 0.5);
+            if (w[i] == 0)
+                w[i] = 1;
         }
     }
 }
 
-void removeNode(int min1, int min2, TREENODE **t, TREENODE *temp)
+int huffmanLengths(uint64_t *counts, int *len, HUFFTREE *ht, int maxLen)
 {
-    t[min1] = temp;
-    t[min2] = NULL;
+    int root = buildTree(counts, ht, MAXSYMBOLS);
+    if (root == -1)
+    {
+        printf("Error: No character has a probability above 0\n");
+        exit(EXIT_FAILURE);
+    }
+    codeLengths(ht, len);
+    int longest = 0;
+    for (int i = 0; i < MAXSYMBOLS; i++)
+        if (len[i] > longest)
+            longest = len[i];
+    if (maxLen > 0 && longest > maxLen && limitLengths(counts, len, MAXSYMBOLS, maxLen) == -1)
+    {
+        printf("Error: Codes of %d bits are too short for every character\n", maxLen);
+        exit(EXIT_FAILURE);
+    }
+    return root;
+}
+
+void reportLimit(uint64_t *counts, int *len, HUFFTREE *ht, int maxLen)
+{
+    int treeLen[MAXSYMBOLS];
+    codeLengths(ht, treeLen);
+    uint64_t limited = codeBits(counts, len, MAXSYMBOLS);
+    uint64_t best = codeBits(counts, treeLen, MAXSYMBOLS);
+    if (limited != best && best > 0)
+        printf("Codes limited to %d bits: %.3f%% larger output\n", maxLen, 100.0 * (double)(limited - best) / (double)best);
 }
 
-void decompFile(char *input, char *output, TREENODE **t, int i)
+void decompFile(char *input, char *output, int *len)
 {
     FILE *fp1 = fopen(input, "r");
     if (fp1 == NULL)
@@ -156,86 +183,72 @@ void decompFile(char *input, char *output, TREENODE **t, int i)
         fclose(fp1);
         exit(EXIT_FAILURE);
     }
-    int temp = 0;
-    TREENODE *current = t[i];
-    while ((temp = fgetc(fp1)) != EOF)
+    DECODETABLE dt;
+    tableFromLengths(&dt, len, MAXSYMBOLS);
+    BITREADER br;
+    openTextReader(&br, fp1);
+    while (moreBits(&br))
     {
-        if (temp == '0')
-            current = current->left;
-        else
-            current = current->right;
-        if (current->c != -1)
+        int c = decodeSymbol(&dt, &br);
+        if (c == -1)
         {
-            fprintf(fp2, "%c", current->c);
-            current = t[i];
+            printf("Error: %s ends in the middle of a code\n", input);
+            break;
         }
+        fputc(c, fp2);
     }
+    closeReader(&br);
+    freeTable(&dt);
     fclose(fp1);
     fclose(fp2);
 }
 
-void freeTree(TREENODE *node)
+void freeTree(HUFFTREE *ht)
 {
-    if (node != NULL)
-    {
-        freeTree(node->left);
-        freeTree(node->right);
-        free(node);
-    }
+    free(ht->nodes);
+    ht->nodes = NULL;
+    ht->text = NULL;
+    ht->size = 0;
+    ht->root = -1;
+    ht->capacity = 0;
 }
 
 #ifdef DEBUG2
+#include "probability.h"
+
 int main()
 {
-    TREENODE **t = (TREENODE **)malloc(128 * sizeof(TREENODE *));
-    if (t == NULL)
-    {
-        perror("Memory allocation failed");
-        exit(EXIT_FAILURE);
-    }
-    float *f = (float *)malloc(128 * sizeof(float));
+    HUFFTREE t = {NULL, 0, -1, 0, NULL};
+    float *f = (float *)malloc(MAXSYMBOLS * sizeof(float));
     if (f == NULL)
     {
         perror("Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
-    for (int i = 0; i < 128; i++)
+    for (int i = 0; i < MAXSYMBOLS; i++)
         f[i] = 0.0;
     probFile("sample.txt", "probfile.txt", f);
 
-    char **c = (char **)malloc(129 * sizeof(char *));
+    char **c = (char **)malloc((MAXSYMBOLS + 1) * sizeof(char *));
     if (c == NULL)
     {
         perror("Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
-    for (int i = 0; i < 128; i++)
+    for (int i = 0; i < MAXSYMBOLS; i++)
     {
         c[i] = NULL;
     }
 
-    int count = huffmanT(f, c, t);
+    int len[MAXSYMBOLS];
+    huffmanT(f, c, len, &t, 0);
     printf("\n");
-    decompFile("data.txt.enc", "data.txt.new", t, count);
-    // Free the allocated memory for the tree
-    for (int i = 0; i < 128; i++)
-    {
-        if (c[i] != NULL)
-        {
-            free(c[i]);
-        }
-    }
+    decompFile("data.txt.enc", "data.txt.new", len);
+    // Free the allocated memory for the tree, which holds the codes
     free(c);
-    for (int i = 0; i < 128; i++)
-    {
-        if (t[i] != NULL)
-        {
-            freeTree(t[i]);
-        }
-    }
+    freeTree(&t);
     // Free other dynamically allocated arrays
     free(f);
-    free(t);
     return 0;
 }
 #endif
\ No newline at end of file
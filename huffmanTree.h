@@ -14,89 +14,142 @@
  */
 
 #include <math.h>
+#include <stdint.h>
 #include "file.h"
 
 #ifndef HUFFMANH
 #define HUFFMANH
 
+/** Number of characters in the alphabet, one per byte value. */
+#define SYMBOLS 256
+
+/** Optional end-of-stream symbol, coded after the last character. */
+#define EOS SYMBOLS
+
+/** Size of the arrays that hold every character and the end-of-stream symbol. */
+#define MAXSYMBOLS (SYMBOLS + 1)
+
+/** Child index of a leaf, which has no children. */
+#define NONODE 0xffff
+
+/** Number of nodes a tree has room for, enough for MAXSYMBOLS characters. */
+#define TREENODES (2 * MAXSYMBOLS - 1)
+
 /**
  * @struct TREENODE
  * @brief Structure representing a node in the Huffman tree.
+ *
+ * Children are 16-bit indices into the node array of the tree instead of
+ * pointers, so a node takes 16 bytes and a whole tree stays in a few cache
+ * lines.
  */
 typedef struct TreeNode
 {
-    int c;                  /**< Character */
-    float data;             /**< Frequency or data associated with the node */
-    struct TreeNode *left;  /**< Pointer to the left child node */
-    struct TreeNode *right; /**< Pointer to the right child node */
+    uint64_t data;  /**< Count or weight associated with the node */
+    int16_t c;      /**< Character, -1 for an internal node */
+    uint16_t left;  /**< Index of the left child node, NONODE for a leaf */
+    uint16_t right; /**< Index of the right child node, NONODE for a leaf */
 } TREENODE;
 
 /**
- * @brief Creates a Huffman tree.
+ * @struct HUFFTREE
+ * @brief A Huffman tree whose nodes and code strings share one arena.
  *
- * Using recursion, this function creates a binary tree for the nodes that
- * were created before.
+ * The arena holds room for TREENODES nodes followed by the code strings
+ * (see codeStrings). Initialize it with {NULL, 0, -1, 0, NULL}. Rebuilding a
+ * tree reuses its arena, and freeTree releases everything with one free.
+ */
+typedef struct HuffTree
+{
+    TREENODE *nodes; /**< Leaves first, then the internal nodes in creation order; the start of the arena */
+    int size;        /**< Number of nodes in the array */
+    int root;        /**< Index of the root node, -1 if the tree is empty */
+    int capacity;    /**< Number of bytes in the arena */
+    char *text;      /**< Code strings, right after the nodes in the arena */
+} HUFFTREE;
+
+/**
+ * @brief Builds a Huffman tree with a binary min-heap.
+ *
+ * Creates a leaf for every character with a count above 0 and then
+ * repeatedly merges the two nodes with the smallest counts, taken from
+ * a min-heap, which makes the construction O(n log n). Ties are broken by
+ * the position of the nodes in the array (leaves in character order, then
+ * internal nodes in creation order), so the same frequencies always give the
+ * same tree. All 2n-1 nodes are stored in the arena of the tree, which is
+ * kept when the same tree is rebuilt.
+ *
+ * @param counts Array of integer counts (or weights), at most MAXSYMBOLS.
+ * @param ht Tree to build, any previous nodes are replaced.
+ * @param n Number of characters.
+ * @return Index of the root node, -1 if no character has a count above 0.
+ */
+int buildTree(uint64_t *, HUFFTREE *, int);
+
+/**
+ * @brief Makes room for code strings in the arena of a tree.
  *
- * @param count Pointer to the count of nodes.
- * @param t Pointer to an array of TreeNode pointers.
- * @return void
+ * Grows the arena if needed, which can move the nodes, so pointers to them
+ * must be taken again afterwards.
+ *
+ * @param ht Huffman tree.
+ * @param n Number of bytes needed.
+ * @return Room for n bytes, valid until the arena grows or is freed.
  */
-void createTree(int *, TREENODE **);
+char *treeText(HUFFTREE *, size_t);
 
 /**
- * @brief Finds the indices of the two nodes with the minimum data.
+ * @brief Turns probabilities into integer weights for buildTree.
  *
- * Given a lot of nodes, this function finds the 2 minimum frequencies of
- * 2 nodes and returns the index of the first one.
+ * Every probability is scaled by 2^32 and rounded, and a probability above 0
+ * gets a weight of at least 1, so it still gets a code.
  *
- * @param t Array of TreeNode pointers.
- * @param c1 Pointer to store the index of the first minimum node.
- * @param c2 Pointer to store the index of the second minimum node.
- * @param count Number of nodes in the array.
- * @return void.
+ * @param f Array of probabilities.
+ * @param w Array to store the weights.
+ * @param n Number of characters.
+ * @return void
  */
-void findMin(TREENODE **, int *, int *, int);
+void probWeights(float *, uint64_t *, int);
 
 /**
- * @brief Generates a Huffman tree based on the given frequencies.
+ * @brief Builds a Huffman tree from counts and finds the code lengths.
  *
- * This function firstly, creates nodes for all the characters in a file,
- * and then using createTree it creates a binary tree for the characters.
- * Then it stores in an array code the code of each character using the tree.
- * Lastly, it prints the codes.
+ * With a maximum code length, the lengths are limited with limitLengths
+ * (see canonical.h) if the tree is deeper than that, so they no longer
+ * match the tree.
  *
- * @param f Array of frequencies.
- * @param codes Array to store Huffman codes.
- * @param t Array of TreeNode pointers.
+ * @param counts Array of MAXSYMBOLS counts.
+ * @param len Array to store the code lengths.
+ * @param ht Huffman tree.
+ * @param maxLen Longest allowed code length, 0 for no limit.
  * @return Index of the root node in the array.
  */
-int huffmanT(float *, char **, TREENODE **);
+int huffmanLengths(uint64_t *, int *, HUFFTREE *, int);
 
 /**
- * @brief Creates a new TreeNode.
+ * @brief Prints how much limiting the code lengths costs.
  *
- * This function creates a new treenode pointer for the given data.
+ * Compares the size of the input coded with the limited lengths to its size
+ * with the lengths of the Huffman tree, and prints nothing if they match.
  *
- * @param data Frequency of the node.
- * @param c Character.
- * @param l Pointer to the left child node.
- * @param r Pointer to the right child node.
- * @return Pointer to the newly created TreeNode.
+ * @param counts Array of MAXSYMBOLS counts.
+ * @param len Limited code lengths.
+ * @param ht Huffman tree.
+ * @param maxLen Longest allowed code length.
+ * @return void
  */
-TREENODE *createNode(float, int, TREENODE *, TREENODE *);
+void reportLimit(uint64_t *, int *, HUFFTREE *, int);
 
 /**
- * @brief Reads the frequencies from a file and generates a probability file.
+ * @brief Gives the end-of-stream symbol a probability.
  *
- * Reads the frequencies from a given file, generates the probability and
- * prints it to a new file.
+ * The end-of-stream symbol gets the smallest probability of any character,
+ * so that it has one of the longest codes.
  *
- * @param filename Input file.
- * @param filenameOut Output file.
- * @param f Array to store frequencies.
+ * @param f Array of MAXSYMBOLS probabilities.
  * @return void
  */
-void probFile(char *, char *, float *);
+void addEOS(float *);
 
 /**
  * @brief Finds the count of non-zero frequencies.
@@ -109,60 +162,28 @@ void probFile(char *, char *, float *);
  */
 int findCount(float *);
 
-/**
- * @brief Removes two nodes and inserts a new one in the array.
- *
- * This function, puts the new given node(temp) in the tree(t) in the
- * first position and then removes the node in the second position(because
- * the new node was made from the first and the second one).
- *
- * @param min1 Index of the first node to be removed.
- * @param min2 Index of the second node to be removed.
- * @param t Array of TreeNode pointers.
- * @param temp Pointer to the new TreeNode to be inserted.
- */
-void removeNode(int, int, TREENODE **, TREENODE *);
-
-/**
- * @brief Recursively generates Huffman codes for each leaf node in a binary tree.
- *
- * This function traverses a binary tree in a depth-first manner and generates
- * Huffman codes for each leaf node. The Huffman codes are stored in the 'codes'
- * array, where each index represents a character and its corresponding value is
- * the Huffman code as a dynamically allocated string.
- *
- * @param t Pointer to the current node in the binary tree.
- * @param arr Array to store the path to the current node.
- * @param top Current index in the 'arr' array.
- * @param codes Array to store Huffman codes for each leaf node.
- * @return void
- */
-void createArray(TREENODE *, int[], int, char **);
-
 /**
  * @brief Decompresses a file based on the Huffman tree.
  *
- * From a given file that consists of 0 and 1, it goes through the
- * tree until it finds a character with the same code and then it starts from the
- * top of the tree with the next code.
+ * From a given file that consists of 0 and 1, it builds a lookup table from
+ * the code lengths (see lookup.h) and decodes one character per table hit
+ * instead of going through the tree one bit at a time.
  *
  * @param input Compressed input file name.
  * @param output Decompressed output file name.
- * @param t Huffman tree.
- * @param i Index of the root node in the array.
+ * @param len Code lengths found by huffmanT.
  */
-void decompFile(char *, char *, TREENODE **, int);
+void decompFile(char *, char *, int *);
 
 /**
- * @brief Recursively frees the memory allocated for a binary tree.
+ * @brief Frees the memory allocated for a Huffman tree.
  *
- * This function recursively traverses a binary tree starting from the given node
- * and frees the memory allocated for each node in the tree. It uses a post-order
- * traversal to ensure that child nodes are freed before their parent nodes.
+ * The nodes and the code strings share one arena, so this takes a single
+ * call to free no matter the size of the tree.
  *
- * @param node Pointer to the root node of the binary tree to be freed.
+ * @param ht Huffman tree.
  * @return void
  */
-void freeTree(TREENODE *);
+void freeTree(HUFFTREE *);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,343 @@
+#include "lookup.h"
+#include "cpu.h"
+
+// The first k bits of a code of length len
+static uint64_t topBits(uint64_t code, int len, int k)
+{
+    return k == 0 ? 0 : code >> (len - k);
+}
+
+static uint64_t lowBits(uint64_t code, int k)
+{
+    return k >= 64 ? code : code & (((uint64_t)1 << k) - 1);
+}
+
+static int addLevel(DECODETABLE *dt, int width)
+{
+    int base = dt->size;
+    int need = base + (1 << width);
+    if (need > dt->capacity)
+    {
+        while (dt->capacity < need)
+            dt->capacity = dt->capacity == 0 ? (1 << LOOKUPBITS) : dt->capacity * 2;
+        LOOKUPENTRY *temp = (LOOKUPENTRY *)realloc(dt->entry, dt->capacity * sizeof(LOOKUPENTRY));
+        if (temp == NULL)
+        {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+        dt->entry = temp;
+    }
+    for (int i = base; i < need; i++)
+    {
+        dt->entry[i].symbol = -1;
+        dt->entry[i].len = 0;
+        dt->entry[i].sub = 0;
+    }
+    dt->size = need;
+    return base;
+}
+
+// Fills the table for every code that starts with the given prefix of
+// length depth, resolving the next width bits.
+static int buildLevel(DECODETABLE *dt, uint64_t *bits, int *len, int n, uint64_t prefix, int depth, int width)
+{
+    int base = addLevel(dt, width);
+    for (int s = 0; s < n; s++)
+    {
+        if (len[s] <= depth || topBits(bits[s], len[s], depth) != prefix)
+            continue;
+        int rest = len[s] - depth;
+        uint64_t code = lowBits(bits[s], rest);
+        if (rest <= width)
+        {
+            int first = (int)(code << (width - rest));
+            for (int j = 0; j < (1 << (width - rest)); j++)
+            {
+                dt->entry[base + first + j].symbol = s;
+                dt->entry[base + first + j].len = (unsigned char)rest;
+            }
+        }
+        else
+        {
+            // Remember the longest code behind this entry in sub for now
+            LOOKUPENTRY *e = &dt->entry[base + (int)(code >> (rest - width))];
+            e->len = (unsigned char)width;
+            if (rest - width > e->sub)
+                e->sub = (unsigned char)(rest - width);
+        }
+    }
+    for (int i = 0; i < (1 << width); i++)
+    {
+        int longest = dt->entry[base + i].sub;
+        if (longest == 0)
+            continue;
+        int subWidth = longest < LOOKUPBITS ? longest : LOOKUPBITS;
+        int offset = buildLevel(dt, bits, len, n, (prefix << width) | (uint64_t)i, depth + width, subWidth);
+        dt->entry[base + i].symbol = offset;
+        dt->entry[base + i].sub = (unsigned char)subWidth;
+    }
+    return base;
+}
+
+void buildTable(DECODETABLE *dt, uint64_t *bits, int *len, int n)
+{
+    dt->entry = NULL;
+    dt->size = 0;
+    dt->capacity = 0;
+    buildLevel(dt, bits, len, n, 0, 0, LOOKUPBITS);
+}
+
+int tableFromLengths(DECODETABLE *dt, int *len, int n)
+{
+    uint64_t *bits = (uint64_t *)malloc(n * sizeof(uint64_t));
+    if (bits == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    if (canonicalCodes(len, bits, n) == -1)
+    {
+        free(bits);
+        return -1;
+    }
+    buildTable(dt, bits, len, n);
+    free(bits);
+    return 0;
+}
+
+void tableFromTree(DECODETABLE *dt, HUFFTREE *ht)
+{
+    int len[MAXSYMBOLS];
+    codeLengths(ht, len);
+    tableFromLengths(dt, len, MAXSYMBOLS);
+}
+
+int decodeSymbol(DECODETABLE *dt, BITREADER *br)
+{
+    LOOKUPENTRY *e = &dt->entry[peekBits(br, LOOKUPBITS)];
+    while (e->sub != 0)
+    {
+        if (skipBits(br, e->len) == -1)
+            return -1;
+        e = &dt->entry[e->symbol + (int)peekBits(br, e->sub)];
+    }
+    if (e->symbol == -1 || skipBits(br, e->len) == -1)
+        return -1;
+    return e->symbol;
+}
+
+// Tops the bits in acc and avail up to at least 57 with one load while the
+// buffer has 8 bytes left
+KERNELBODY void fillBits(BITREADER *br, uint64_t *acc, int *avail)
+{
+    if (*avail > 56 || br->text || br->len - br->pos < 8)
+        return;
+    const unsigned char *p = br->buf + br->pos;
+    uint64_t w;
+#ifdef WORDBE
+    memcpy(&w, p, 8);
+    w = WORDBE(w);
+#else
+    w = ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) | ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+        ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) | ((uint64_t)p[6] << 8) | p[7];
+#endif
+    int take = (64 - *avail) >> 3;
+    *acc |= w >> *avail;
+    br->pos += take;
+    *avail += 8 * take;
+}
+
+// Number of characters decoded after every fillBits
+#define FILLSYMBOLS (56 / LOOKUPBITS)
+
+// Bits the characters decoded after a fillBits take at most
+#define FILLBITS (FILLSYMBOLS * LOOKUPBITS)
+
+// Decodes one character, without calls when its code is in the first level
+KERNELBODY int nextSymbol(DECODETABLE *dt, BITREADER *br)
+{
+    if (br->avail >= LOOKUPBITS)
+    {
+        LOOKUPENTRY *e = &dt->entry[br->acc >> (64 - LOOKUPBITS)];
+        if (e->sub == 0 && e->symbol >= 0)
+        {
+            br->acc <<= e->len;
+            br->avail -= e->len;
+            return e->symbol;
+        }
+    }
+    return decodeSymbol(dt, br);
+}
+
+// The loops keep the bits of every reader in local variables and decode
+// FILLSYMBOLS characters per refill without checking how many are left.
+// A code that isn't a character of the first level stops the round, and
+// that character is decoded through the reader with nextSymbol, so no call
+// keeps the bits out of registers.
+KERNELBODY int streamsKernel(DECODETABLE *dt, BITREADER *br, int streams, unsigned char *out, size_t n)
+{
+    const LOOKUPENTRY *entry = dt->entry;
+    size_t part = n / streams;
+    size_t done = 0;
+    if (streams == 4)
+    {
+        // The four streams don't depend on each other, so their lookups overlap
+        unsigned char *out1 = out + part;
+        unsigned char *out2 = out1 + part;
+        unsigned char *out3 = out2 + part;
+        uint64_t acc0 = br[0].acc;
+        uint64_t acc1 = br[1].acc;
+        uint64_t acc2 = br[2].acc;
+        uint64_t acc3 = br[3].acc;
+        int avail0 = br[0].avail;
+        int avail1 = br[1].avail;
+        int avail2 = br[2].avail;
+        int avail3 = br[3].avail;
+        while (done < part)
+        {
+            fillBits(&br[0], &acc0, &avail0);
+            fillBits(&br[1], &acc1, &avail1);
+            fillBits(&br[2], &acc2, &avail2);
+            fillBits(&br[3], &acc3, &avail3);
+            size_t end = part - done < FILLSYMBOLS ? part : done + FILLSYMBOLS;
+            if (avail0 >= FILLBITS && avail1 >= FILLBITS && avail2 >= FILLBITS && avail3 >= FILLBITS)
+            {
+                for (; done < end; done++)
+                {
+                    const LOOKUPENTRY *a = &entry[acc0 >> (64 - LOOKUPBITS)];
+                    const LOOKUPENTRY *b = &entry[acc1 >> (64 - LOOKUPBITS)];
+                    const LOOKUPENTRY *c = &entry[acc2 >> (64 - LOOKUPBITS)];
+                    const LOOKUPENTRY *d = &entry[acc3 >> (64 - LOOKUPBITS)];
+                    if ((a->sub | b->sub | c->sub | d->sub) != 0 ||
+                        (unsigned)(a->symbol | b->symbol | c->symbol | d->symbol) >= SYMBOLS)
+                        break;
+                    acc0 <<= a->len;
+                    acc1 <<= b->len;
+                    acc2 <<= c->len;
+                    acc3 <<= d->len;
+                    avail0 -= a->len;
+                    avail1 -= b->len;
+                    avail2 -= c->len;
+                    avail3 -= d->len;
+                    out[done] = (unsigned char)a->symbol;
+                    out1[done] = (unsigned char)b->symbol;
+                    out2[done] = (unsigned char)c->symbol;
+                    out3[done] = (unsigned char)d->symbol;
+                }
+                if (done == end)
+                    continue;
+            }
+            br[0].acc = acc0;
+            br[1].acc = acc1;
+            br[2].acc = acc2;
+            br[3].acc = acc3;
+            br[0].avail = avail0;
+            br[1].avail = avail1;
+            br[2].avail = avail2;
+            br[3].avail = avail3;
+            int a = nextSymbol(dt, &br[0]);
+            int b = nextSymbol(dt, &br[1]);
+            int c = nextSymbol(dt, &br[2]);
+            int d = nextSymbol(dt, &br[3]);
+            if ((unsigned)(a | b | c | d) >= SYMBOLS)
+                return -1;
+            out[done] = (unsigned char)a;
+            out1[done] = (unsigned char)b;
+            out2[done] = (unsigned char)c;
+            out3[done] = (unsigned char)d;
+            done++;
+            acc0 = br[0].acc;
+            acc1 = br[1].acc;
+            acc2 = br[2].acc;
+            acc3 = br[3].acc;
+            avail0 = br[0].avail;
+            avail1 = br[1].avail;
+            avail2 = br[2].avail;
+            avail3 = br[3].avail;
+        }
+        br[0].acc = acc0;
+        br[1].acc = acc1;
+        br[2].acc = acc2;
+        br[3].acc = acc3;
+        br[0].avail = avail0;
+        br[1].avail = avail1;
+        br[2].avail = avail2;
+        br[3].avail = avail3;
+    }
+    for (int s = 0; s < streams; s++)
+    {
+        size_t end = s == streams - 1 ? n - s * part : part;
+        unsigned char *dst = out + s * part;
+        uint64_t acc = br[s].acc;
+        int avail = br[s].avail;
+        size_t i = done;
+        while (i < end)
+        {
+            fillBits(&br[s], &acc, &avail);
+            size_t stop = end - i < FILLSYMBOLS ? end : i + FILLSYMBOLS;
+            if (avail >= FILLBITS)
+            {
+                for (; i < stop; i++)
+                {
+                    const LOOKUPENTRY *e = &entry[acc >> (64 - LOOKUPBITS)];
+                    if (e->sub != 0 || (unsigned)e->symbol >= SYMBOLS)
+                        break;
+                    acc <<= e->len;
+                    avail -= e->len;
+                    dst[i] = (unsigned char)e->symbol;
+                }
+                if (i == stop)
+                    continue;
+            }
+            br[s].acc = acc;
+            br[s].avail = avail;
+            int c = nextSymbol(dt, &br[s]);
+            if ((unsigned)c >= SYMBOLS)
+                return -1;
+            dst[i++] = (unsigned char)c;
+            acc = br[s].acc;
+            avail = br[s].avail;
+        }
+        br[s].acc = acc;
+        br[s].avail = avail;
+    }
+    return 0;
+}
+
+static int streamsScalar(DECODETABLE *dt, BITREADER *br, int streams, unsigned char *out, size_t n)
+{
+    return streamsKernel(dt, br, streams, out, n);
+}
+
+#if CPUX86
+// The same loop with shlx for consuming the codes
+KERNEL("bmi2") static int streamsBMI2(DECODETABLE *dt, BITREADER *br, int streams, unsigned char *out, size_t n)
+{
+    return streamsKernel(dt, br, streams, out, n);
+}
+#endif
+
+// The kernel the CPU supports, picked once before main
+static int (*streamsBest)(DECODETABLE *, BITREADER *, int, unsigned char *, size_t) = streamsScalar;
+
+#if CPUX86
+KERNELSELECT static void selectStreams(void)
+{
+    if (cpuFeatures() & CPUBMI2)
+        streamsBest = streamsBMI2;
+}
+#endif
+
+int decodeStreams(DECODETABLE *dt, BITREADER *br, int streams, unsigned char *out, size_t n)
+{
+    return streamsBest(dt, br, streams, out, n);
+}
+
+void freeTable(DECODETABLE *dt)
+{
+    free(dt->entry);
+    dt->entry = NULL;
+    dt->size = 0;
+    dt->capacity = 0;
+}
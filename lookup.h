@@ -0,0 +1,120 @@
+/**
+ * @file lookup.h
+ * @brief Table-driven Huffman decoder.
+ *
+ * Instead of walking the Huffman tree one bit at a time, the decoder peeks
+ * at the next LOOKUPBITS bits of the stream and looks them up in a table
+ * that gives the decoded character and the length of its code. Codes longer
+ * than LOOKUPBITS are resolved through second (and further) level tables that
+ * are linked from the first one, so most characters decode in one table hit.
+ *
+ * The tables can be built from a code table, from code lengths (canonical
+ * codes) or from a Huffman tree, and decode both the packed and the textual
+ * format through a BITREADER.
+ *
+ * @see bitio.h
+ * @see canonical.h
+ */
+
+#include "bitio.h"
+#include "canonical.h"
+
+#ifndef LOOKUPH
+#define LOOKUPH
+
+/** Number of bits resolved by the first level table (and by each next level). */
+#define LOOKUPBITS 11
+
+/**
+ * @struct LOOKUPENTRY
+ * @brief One entry of a decoding table.
+ */
+typedef struct LookupEntry
+{
+    int symbol;        /**< Decoded character, offset of the next level table or -1 if invalid */
+    unsigned char len; /**< Number of bits consumed by this entry */
+    unsigned char sub; /**< Width of the next level table, 0 if the entry is a character */
+} LOOKUPENTRY;
+
+/**
+ * @struct DECODETABLE
+ * @brief All the levels of a decoding table in one array.
+ */
+typedef struct DecodeTable
+{
+    LOOKUPENTRY *entry; /**< First level table followed by the next level tables */
+    int size;           /**< Number of entries used */
+    int capacity;       /**< Number of entries allocated */
+} DECODETABLE;
+
+/**
+ * @brief Builds a decoding table from a code table.
+ *
+ * Characters with a code length of 0 have no code.
+ *
+ * @param dt Table to build.
+ * @param bits Code of every character, right-aligned.
+ * @param len Code length of every character.
+ * @param n Number of characters.
+ * @return void
+ */
+void buildTable(DECODETABLE *, uint64_t *, int *, int);
+
+/**
+ * @brief Builds a decoding table for the canonical codes of the given lengths.
+ *
+ * @param dt Table to build.
+ * @param len Code length of every character, 0 if it has no code.
+ * @param n Number of characters.
+ * @return 0 on success, -1 if the lengths do not describe a prefix code.
+ */
+int tableFromLengths(DECODETABLE *, int *, int);
+
+/**
+ * @brief Builds a decoding table from a Huffman tree.
+ *
+ * Takes the code lengths from the tree and builds the table for the
+ * canonical codes of those lengths, which are the codes huffmanT hands out.
+ *
+ * @param dt Table to build.
+ * @param ht Huffman tree.
+ * @return void
+ */
+void tableFromTree(DECODETABLE *, HUFFTREE *);
+
+/**
+ * @brief Decodes the next character from a bit reader.
+ *
+ * @param dt Decoding table.
+ * @param br Bit reader.
+ * @return The character, or -1 if the bits are not a valid code or the
+ *         input ended in the middle of a code.
+ */
+int decodeSymbol(DECODETABLE *, BITREADER *);
+
+/**
+ * @brief Decodes bytes from one or more independent bitstreams.
+ *
+ * The output is split into `streams` parts of n / streams bytes, the last
+ * part taking the remainder, and part s is decoded from br[s]. With four
+ * streams one loop iteration decodes a byte from each, so the lookups of
+ * the streams run in parallel instead of waiting on each other.
+ *
+ * @param dt Decoding table, without an end-of-stream code.
+ * @param br Array of `streams` bit readers.
+ * @param streams Number of streams.
+ * @param out Buffer to store the n decoded bytes.
+ * @param n Number of bytes to decode.
+ * @return 0 on success, -1 if a stream is truncated or corrupted.
+ */
+int decodeStreams(DECODETABLE *, BITREADER *, int, unsigned char *, size_t);
+
+/**
+ * @brief Frees the memory of a decoding table.
+ *
+ * @param dt Decoding table.
+ * @return void
+ */
+void freeTable(DECODETABLE *);
+
+#endif
@@ -0,0 +1,99 @@
+// mmap and posix_madvise are POSIX, not C99
+#define _POSIX_C_SOURCE 200112L
+
+#include "mapfile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Maps a regular file, returns 0 if it was mapped
+static int mapInput(INPUTFILE *in, char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        return -1;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return -1;
+    }
+    in->size = (size_t)st.st_size;
+    in->data = NULL;
+    if (in->size > 0)
+    {
+        void *p = mmap(NULL, in->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close(fd);
+            return -1;
+        }
+        posix_madvise(p, in->size, POSIX_MADV_SEQUENTIAL);
+        in->data = (unsigned char *)p;
+    }
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    in->fp = NULL;
+    in->mapped = 1;
+    in->done = 0;
+    return 0;
+}
+
+int openInput(INPUTFILE *in, char *filename)
+{
+    if (mapInput(in, filename) == 0)
+        return 0;
+    in->fp = fopen(filename, "rb");
+    if (in->fp == NULL)
+        return -1;
+    in->data = (unsigned char *)malloc(INPUTBLOCK);
+    if (in->data == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    in->size = 0;
+    in->mapped = 0;
+    in->done = 0;
+    return 0;
+}
+
+size_t nextInput(INPUTFILE *in, const unsigned char **chunk)
+{
+    *chunk = in->data;
+    if (in->mapped)
+    {
+        if (in->done)
+            return 0;
+        in->done = 1;
+        return in->size;
+    }
+    in->size = fread(in->data, 1, INPUTBLOCK, in->fp);
+    return in->size;
+}
+
+int rewindInput(INPUTFILE *in)
+{
+    if (in->mapped)
+    {
+        in->done = 0;
+        return 0;
+    }
+    return fseek(in->fp, 0, SEEK_SET) == 0 ? 0 : -1;
+}
+
+void closeInput(INPUTFILE *in)
+{
+    if (in->mapped)
+    {
+        if (in->data != NULL)
+            munmap(in->data, in->size);
+    }
+    else
+    {
+        free(in->data);
+        fclose(in->fp);
+    }
+    in->data = NULL;
+}
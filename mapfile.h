@@ -0,0 +1,73 @@
+/**
+ * @file mapfile.h
+ * @brief Zero-copy input files.
+ *
+ * An INPUTFILE hands out the contents of a file in large chunks. Regular
+ * files are mapped into memory with mmap and handed out as one chunk, so
+ * passes over the input work directly on the page cache without copying or
+ * calling libc per character, and the kernel is told the mapping is read
+ * sequentially. Files that can't be mapped, like pipes, fall back to fread
+ * into a buffer of INPUTBLOCK bytes.
+ *
+ * @see histogram.h
+ * @see packed.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef MAPFILEH
+#define MAPFILEH
+
+/** Size in bytes of the chunks read from files that can't be mapped. */
+#define INPUTBLOCK (1 << 20)
+
+/**
+ * @struct INPUTFILE
+ * @brief An input file that is either mapped or read in chunks.
+ */
+typedef struct InputFile
+{
+    FILE *fp;            /**< Open file, NULL when the file is mapped */
+    unsigned char *data; /**< Mapping of the file, or the read buffer */
+    size_t size;         /**< Size of the mapping, or of the last chunk read */
+    int mapped;          /**< Set if data is a mapping of the whole file */
+    int done;            /**< Set once the mapping was handed out */
+} INPUTFILE;
+
+/**
+ * @brief Opens a file for reading, mapping it if it is a regular file.
+ *
+ * @param in Input file to initialize.
+ * @param filename File name.
+ * @return 0 on success, -1 if the file can't be opened.
+ */
+int openInput(INPUTFILE *, char *);
+
+/**
+ * @brief Gets the next chunk of the file.
+ *
+ * @param in Input file.
+ * @param chunk Pointer to store the start of the chunk, which stays valid
+ *              until the next call or closeInput.
+ * @return Number of bytes in the chunk, 0 at the end of the file.
+ */
+size_t nextInput(INPUTFILE *, const unsigned char **);
+
+/**
+ * @brief Starts handing out the file from the beginning again.
+ *
+ * @param in Input file.
+ * @return 0 on success, -1 if the file can't be rewound, like a pipe.
+ */
+int rewindInput(INPUTFILE *);
+
+/**
+ * @brief Unmaps or closes a file.
+ *
+ * @param in Input file.
+ * @return void
+ */
+void closeInput(INPUTFILE *);
+
+#endif
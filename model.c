@@ -0,0 +1,163 @@
+#include "model.h"
+
+// Bytes before the native part of a model file
+#define MODELHEAD (4 + 1 + 1 + 1 + 8 + MAXSYMBOLS)
+
+// Bytes before the entries of the decoding table
+#define MODELTABLE (MODELHEAD + 5 * 4)
+
+int hashFile(char *filename, uint64_t *hash)
+{
+    INPUTFILE in;
+    if (openInput(&in, filename) == -1)
+        return -1;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    const unsigned char *chunk;
+    size_t n;
+    while ((n = nextInput(&in, &chunk)) > 0)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            h ^= chunk[i];
+            h *= 0x100000001b3ULL;
+        }
+    }
+    closeInput(&in);
+    *hash = h;
+    return 0;
+}
+
+// Fills in the codes and the encoding table from the code lengths
+static int finishModel(CODEMODEL *m)
+{
+    if (canonicalCodes(m->len, m->bits, MAXSYMBOLS) == -1)
+        return -1;
+    m->longest = encodeTable(m->table, m->len, m->bits, MAXSYMBOLS);
+    return 0;
+}
+
+void modelFromCounts(CODEMODEL *m, uint64_t *counts, int maxLen)
+{
+    HUFFTREE ht = {NULL, 0, -1, 0, NULL};
+    huffmanLengths(counts, m->len, &ht, maxLen);
+    freeTree(&ht);
+    m->hash = 0;
+    m->eos = m->len[EOS] > 0;
+    m->maxLen = maxLen;
+    finishModel(m);
+    tableFromLengths(&m->dt, m->len, MAXSYMBOLS);
+    m->mapped = 0;
+}
+
+// 32-bit FNV-1a of the code lengths and the fields of every table entry,
+// which ties a stored decoding table to the lengths stored with it
+static uint32_t tableCheck(int *len, LOOKUPENTRY *entry, uint32_t size)
+{
+    uint32_t h = 0x811c9dc5u;
+    for (int i = 0; i < MAXSYMBOLS; i++)
+        h = (h ^ (uint32_t)len[i]) * 0x01000193u;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        h = (h ^ (uint32_t)entry[i].symbol) * 0x01000193u;
+        h = (h ^ entry[i].len) * 0x01000193u;
+        h = (h ^ entry[i].sub) * 0x01000193u;
+    }
+    return h;
+}
+
+void saveModel(CODEMODEL *m, char *output)
+{
+    FILE *fp = fopen(output, "wb");
+    if (fp == NULL)
+    {
+        perror("Error opening output file");
+        exit(EXIT_FAILURE);
+    }
+    fwrite(MODELMAGIC, 1, 4, fp);
+    fputc(MODELVERSION, fp);
+    fputc(m->eos ? MODELEOS : 0, fp);
+    fputc(m->maxLen, fp);
+    writeU64(fp, m->hash);
+    for (int i = 0; i < MAXSYMBOLS; i++)
+        fputc(m->len[i], fp);
+    uint32_t native[5] = {MODELMARKER, (uint32_t)sizeof(LOOKUPENTRY), LOOKUPBITS, (uint32_t)m->dt.size,
+                          tableCheck(m->len, m->dt.entry, (uint32_t)m->dt.size)};
+    fwrite(native, sizeof(uint32_t), 5, fp);
+    fwrite(m->dt.entry, sizeof(LOOKUPENTRY), m->dt.size, fp);
+    if (fclose(fp) != 0)
+    {
+        perror("Error writing output file");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Checks that every link of a stored decoding table stays inside it
+static int validTable(LOOKUPENTRY *entry, uint32_t size)
+{
+    if (size < (1u << LOOKUPBITS))
+        return 0;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        if (entry[i].sub == 0)
+        {
+            if (entry[i].symbol >= MAXSYMBOLS || entry[i].symbol < -1 || entry[i].len > LOOKUPBITS)
+                return 0;
+        }
+        else if (entry[i].symbol < 0 || entry[i].sub > LOOKUPBITS || entry[i].len > LOOKUPBITS ||
+                 (uint32_t)entry[i].symbol + (1u << entry[i].sub) > size)
+            return 0;
+    }
+    return 1;
+}
+
+int loadModel(CODEMODEL *m, char *input)
+{
+    if (openInput(&m->file, input) == -1)
+        return -1;
+    const unsigned char *p;
+    size_t size = nextInput(&m->file, &p);
+    // Model files are always regular files, so they can be mapped
+    if (!m->file.mapped || size < MODELTABLE || memcmp(p, MODELMAGIC, 4) != 0 || p[4] != MODELVERSION)
+    {
+        closeInput(&m->file);
+        return -1;
+    }
+    m->eos = (p[5] & MODELEOS) != 0;
+    m->maxLen = p[6];
+    m->hash = 0;
+    for (int i = 0; i < 8; i++)
+        m->hash = (m->hash << 8) | p[7 + i];
+    for (int i = 0; i < MAXSYMBOLS; i++)
+        m->len[i] = p[15 + i];
+    if ((!m->eos && m->len[EOS] != 0) || finishModel(m) == -1)
+    {
+        closeInput(&m->file);
+        return -1;
+    }
+    uint32_t native[5];
+    memcpy(native, p + MODELHEAD, sizeof(native));
+    m->mapped = native[0] == MODELMARKER && native[1] == sizeof(LOOKUPENTRY) && native[2] == LOOKUPBITS &&
+                (size - MODELTABLE) / sizeof(LOOKUPENTRY) >= native[3] &&
+                validTable((LOOKUPENTRY *)(p + MODELTABLE), native[3]) &&
+                tableCheck(m->len, (LOOKUPENTRY *)(p + MODELTABLE), native[3]) == native[4];
+    if (m->mapped)
+    {
+        // The table is used in place, straight from the page cache
+        m->dt.entry = (LOOKUPENTRY *)(p + MODELTABLE);
+        m->dt.size = (int)native[3];
+        m->dt.capacity = (int)native[3];
+        return 0;
+    }
+    closeInput(&m->file);
+    tableFromLengths(&m->dt, m->len, MAXSYMBOLS);
+    return 0;
+}
+
+void freeModel(CODEMODEL *m)
+{
+    if (m->mapped)
+        closeInput(&m->file);
+    else
+        freeTable(&m->dt);
+    m->mapped = 0;
+}
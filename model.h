@@ -0,0 +1,118 @@
+/**
+ * @file model.h
+ * @brief Compiled and cached code tables.
+ *
+ * A CODEMODEL holds everything -e and -d need from a probability file: the
+ * code lengths, the canonical codes, the encoding table and the decoding
+ * table. Building it means parsing the probability file and building the
+ * tree, so a model can be compiled once into a model file and loaded from
+ * there. Models built from probability files and the in-process cache are
+ * in probability.h.
+ *
+ * A model file consists of:
+ *
+ * - a 4 byte magic "HUFM" and a 1 byte format version,
+ * - a 1 byte flags field (MODELEOS if the end-of-stream symbol has a code),
+ * - the maximum code length the model was built with (0 for no limit),
+ * - the fingerprint of the probability file as a 64-bit big-endian integer,
+ * - 257 bytes with the code length of every character and of the
+ *   end-of-stream symbol,
+ * - a byte order marker, the size of a table entry, LOOKUPBITS, the
+ *   number of entries of the decoding table and a checksum of the code
+ *   lengths and the entries as native 32-bit integers, followed by the
+ *   entries themselves.
+ *
+ * When the marker, the entry size and LOOKUPBITS match and the checksum
+ * shows the table belongs to the code lengths, loadModel maps the file and
+ * uses the decoding table in place, without building anything. Otherwise
+ * the table is rebuilt from the code lengths.
+ *
+ * @see lookup.h
+ * @see mapfile.h
+ */
+
+#include "lookup.h"
+#include "mapfile.h"
+
+#ifndef MODELH
+#define MODELH
+
+/** Magic bytes at the start of every model file. */
+#define MODELMAGIC "HUFM"
+
+/** Current version of the model format. */
+#define MODELVERSION 2
+
+/** Flag set when the model has an end-of-stream symbol. */
+#define MODELEOS 0x01
+
+/** Written in native byte order to tell if a model file can be used in place. */
+#define MODELMARKER 0x01020304
+
+/**
+ * @struct CODEMODEL
+ * @brief A compiled code table.
+ */
+typedef struct CodeModel
+{
+    uint64_t hash;               /**< Fingerprint of the probability file */
+    int eos;                     /**< 1 if the end-of-stream symbol has a code */
+    int maxLen;                  /**< Code length limit it was built with, 0 for none */
+    int len[MAXSYMBOLS];         /**< Code lengths */
+    uint64_t bits[MAXSYMBOLS];   /**< Canonical codes */
+    CODEENTRY table[MAXSYMBOLS]; /**< Encoding table for writeSymbols */
+    int longest;                 /**< Longest code length */
+    DECODETABLE dt;              /**< Decoding table */
+    INPUTFILE file;              /**< Model file the decoding table is mapped from */
+    int mapped;                  /**< Set if dt points into file */
+} CODEMODEL;
+
+/**
+ * @brief Computes the fingerprint of a file (64-bit FNV-1a of its bytes).
+ *
+ * @param filename File name.
+ * @param hash Pointer to store the fingerprint.
+ * @return 0 on success, -1 if the file can't be opened.
+ */
+int hashFile(char *, uint64_t *);
+
+/**
+ * @brief Builds a model from byte counts, for example of sample records.
+ *
+ * The model has no fingerprint, so it is not cached.
+ *
+ * @param m Model to build.
+ * @param counts Array of MAXSYMBOLS counts, the end-of-stream symbol gets
+ *               a code if its count is above 0.
+ * @param maxLen Longest allowed code length, 0 for no limit.
+ * @return void
+ */
+void modelFromCounts(CODEMODEL *, uint64_t *, int);
+
+/**
+ * @brief Writes a model to a model file.
+ *
+ * @param m Model.
+ * @param output Model file name.
+ * @return void
+ */
+void saveModel(CODEMODEL *, char *);
+
+/**
+ * @brief Loads a model file, mapping its decoding table if possible.
+ *
+ * @param m Model to load.
+ * @param input Model file name.
+ * @return 0 on success, -1 if the file is not a valid model file.
+ */
+int loadModel(CODEMODEL *, char *);
+
+/**
+ * @brief Frees the memory of a model and unmaps its file.
+ *
+ * @param m Model.
+ * @return void
+ */
+void freeModel(CODEMODEL *);
+
+#endif
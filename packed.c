@@ -0,0 +1,419 @@
+#include "packed.h"
+#include "histogram.h"
+#include "lookup.h"
+#include "mapfile.h"
+#include "stats.h"
+
+// Size of the buffer decoded characters are collected in
+#define PACKEDOUT (1 << 16)
+
+uint64_t encPackedFile(int *len, CODEMODEL *model, char *input, char *output, uint32_t interval)
+{
+    double timer = STATBEGIN();
+    uint64_t codes[MAXSYMBOLS];
+    CODEENTRY built[MAXSYMBOLS];
+    // A compiled model already has the codes and the encoding table
+    uint64_t *bits = codes;
+    CODEENTRY *table = built;
+    int maxLen;
+    if (model != NULL)
+    {
+        len = model->len;
+        bits = model->bits;
+        table = model->table;
+        maxLen = model->longest;
+    }
+    else
+    {
+        if (canonicalCodes(len, bits, MAXSYMBOLS) == -1)
+        {
+            printf("Error: Code lengths do not describe a prefix code\n");
+            exit(EXIT_FAILURE);
+        }
+        maxLen = encodeTable(table, len, bits, SYMBOLS);
+    }
+    int eos = len[EOS] > 0;
+    INPUTFILE in;
+    if (openInput(&in, input) == -1)
+    {
+        perror("Error opening input file");
+        exit(EXIT_FAILURE);
+    }
+    FILE *fp2 = fopen(output, "wb");
+    if (fp2 == NULL)
+    {
+        perror("Error opening output file");
+        closeInput(&in);
+        exit(EXIT_FAILURE);
+    }
+    fwrite(PACKEDMAGIC, 1, 4, fp2);
+    fputc(PACKEDVERSION, fp2);
+    fputc((eos ? PACKEDEOS : 0) | (interval > 0 ? PACKEDINDEX : 0), fp2);
+    long lengthPos = ftell(fp2);
+    writeU64(fp2, 0); // patched once the input length is known
+    for (int i = 0; i < (eos ? MAXSYMBOLS : SYMBOLS); i++)
+        fputc(len[i], fp2);
+    BITWRITER bw;
+    openWriter(&bw, fp2);
+    uint64_t n = 0;
+    uint64_t *index = NULL;
+    size_t entries = 0;
+    size_t capacity = 0;
+    const unsigned char *chunk;
+    size_t k;
+    while ((k = nextInput(&in, &chunk)) > 0)
+    {
+        for (size_t i = 0; i < k;)
+        {
+            // The chunk is split where the index needs the bit offset
+            size_t part = k - i;
+            if (interval > 0)
+            {
+                uint64_t into = (n + i) % interval;
+                if (into == 0)
+                {
+                    if (entries == capacity)
+                    {
+                        capacity = capacity == 0 ? 64 : capacity * 2;
+                        uint64_t *temp = (uint64_t *)realloc(index, capacity * sizeof(uint64_t));
+                        if (temp == NULL)
+                        {
+                            perror("Memory allocation failed");
+                            exit(EXIT_FAILURE);
+                        }
+                        index = temp;
+                    }
+                    index[entries++] = bw.bits;
+                }
+                if (part > interval - into)
+                    part = (size_t)(interval - into);
+            }
+            if (writeSymbols(&bw, chunk + i, part, table, maxLen) == -1)
+            {
+                while (len[chunk[i]] > 0)
+                    i++;
+                printf("Error: Character %d of %s has no code\n", chunk[i], input);
+                exit(EXIT_FAILURE);
+            }
+            i += part;
+        }
+        n += k;
+    }
+    if (eos)
+        writeBits(&bw, bits[EOS], len[EOS]);
+    uint64_t coded = bw.bits;
+    STATPAYLOAD(coded);
+    closeWriter(&bw);
+    if (interval > 0)
+    {
+        for (size_t i = 0; i < entries; i++)
+            writeU64(fp2, index[i]);
+        writeU64(fp2, entries);
+        writeU32(fp2, interval);
+        fwrite(PACKEDINDEXMAGIC, 1, 4, fp2);
+    }
+    free(index);
+    fseek(fp2, lengthPos, SEEK_SET);
+    writeU64(fp2, n);
+    closeInput(&in);
+    if (fclose(fp2) != 0)
+    {
+        perror("Error writing output file");
+        exit(EXIT_FAILURE);
+    }
+    STATEND(STATENCODE, timer, n);
+    return coded;
+}
+
+// Reads the header of a packed file up to the bitstream and returns its flags
+static int readHeader(FILE *fp1, char *input, int *len, uint64_t *n)
+{
+    char magic[4];
+    if (fread(magic, 1, 4, fp1) != 4 || memcmp(magic, PACKEDMAGIC, 4) != 0)
+    {
+        printf("Error: %s is not a packed file (use -t for the text format)\n", input);
+        fclose(fp1);
+        exit(EXIT_FAILURE);
+    }
+    int version = fgetc(fp1);
+    int flags = fgetc(fp1);
+    if (version != PACKEDVERSION || flags == EOF)
+    {
+        printf("Error: Unsupported packed format version %d\n", version);
+        fclose(fp1);
+        exit(EXIT_FAILURE);
+    }
+    *n = readU64(fp1);
+    len[EOS] = 0;
+    for (int j = 0; j < ((flags & PACKEDEOS) != 0 ? MAXSYMBOLS : SYMBOLS); j++)
+    {
+        len[j] = fgetc(fp1);
+        if (len[j] == EOF)
+        {
+            printf("Error: Packed file header is truncated\n");
+            fclose(fp1);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return flags;
+}
+
+void decompPackedFile(char *input, char *output, int *expected, CODEMODEL *model)
+{
+    double timer = STATBEGIN();
+    FILE *fp1 = fopen(input, "rb");
+    if (fp1 == NULL)
+    {
+        perror("Error opening input file");
+        exit(EXIT_FAILURE);
+    }
+    int len[MAXSYMBOLS];
+    uint64_t n;
+    int eos = (readHeader(fp1, input, len, &n) & PACKEDEOS) != 0;
+    if (model != NULL)
+        expected = model->len;
+    if (expected != NULL && eos != (expected[EOS] > 0))
+    {
+        printf("Error: %s was encoded %s an end-of-stream symbol (-z)\n", input, eos ? "with" : "without");
+        exit(EXIT_FAILURE);
+    }
+    // The stored code table must be the one built from the probability file
+    for (int j = 0; expected != NULL && j < MAXSYMBOLS; j++)
+    {
+        if (len[j] != expected[j])
+        {
+            printf("Error: %s was encoded with a different probability file\n", input);
+            exit(EXIT_FAILURE);
+        }
+    }
+    FILE *fp2 = fopen(output, "wb");
+    if (fp2 == NULL)
+    {
+        perror("Error opening output file");
+        fclose(fp1);
+        exit(EXIT_FAILURE);
+    }
+    // The lengths match the model, so its decoding table is used as it is
+    DECODETABLE table;
+    DECODETABLE *dt = &table;
+    if (model != NULL)
+        dt = &model->dt;
+    else if (tableFromLengths(dt, len, MAXSYMBOLS) == -1)
+    {
+        printf("Error: Packed file header is corrupted\n");
+        exit(EXIT_FAILURE);
+    }
+    // The bitstream is decoded straight from the mapped file if possible
+    long start = ftell(fp1);
+    INPUTFILE in;
+    const unsigned char *data = NULL;
+    size_t size = 0;
+    int mapped = 0;
+    if (openInput(&in, input) == 0)
+    {
+        mapped = in.mapped;
+        if (mapped)
+            size = nextInput(&in, &data);
+        else
+            closeInput(&in);
+    }
+    BITREADER br;
+    if (mapped && start >= 0 && (size_t)start <= size)
+        openBufferReader(&br, data + start, size - start);
+    else
+        openReader(&br, fp1);
+    unsigned char *buf = (unsigned char *)malloc(PACKEDOUT);
+    if (buf == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    size_t used = 0;
+    // With an end-of-stream symbol the stream ends itself, the length is
+    // only used to check that nothing was lost
+    uint64_t k = 0;
+    while (eos || k < n)
+    {
+        int c = decodeSymbol(dt, &br);
+        if (c == EOS)
+            break;
+        if (c == -1)
+        {
+            printf("Error: %s is truncated or corrupted\n", input);
+            exit(EXIT_FAILURE);
+        }
+        buf[used++] = (unsigned char)c;
+        if (used == PACKEDOUT)
+        {
+            fwrite(buf, 1, used, fp2);
+            used = 0;
+        }
+        k++;
+    }
+    fwrite(buf, 1, used, fp2);
+    if (k != n)
+    {
+        printf("Error: %s decoded to %llu characters instead of %llu\n", input, (unsigned long long)k, (unsigned long long)n);
+        exit(EXIT_FAILURE);
+    }
+    if (model == NULL)
+        freeTable(dt);
+    STATPAYLOAD(bitsRead(&br));
+    closeReader(&br);
+    if (mapped)
+        closeInput(&in);
+    free(buf);
+    fclose(fp1);
+    if (fclose(fp2) != 0)
+    {
+        perror("Error writing output file");
+        exit(EXIT_FAILURE);
+    }
+    STATEND(STATDECODE, timer, n);
+}
+
+void compressFile(char *input, char *output, int eos, int maxLen, uint32_t interval, int samples)
+{
+    uint64_t counts[MAXSYMBOLS];
+    for (int i = 0; i < MAXSYMBOLS; i++)
+        counts[i] = 0;
+    double timer = STATBEGIN();
+    long long sampled = 0;
+    long long total = samples > 0 ? sampleFile(input, counts, samples, &sampled) : histFile(input, counts);
+    if (total == -1)
+    {
+        perror("Error opening input file");
+        exit(EXIT_FAILURE);
+    }
+    STATEND(STATHISTOGRAM, timer, (uint64_t)(samples > 0 ? sampled : total));
+    if (eos)
+        counts[EOS] = 1;
+    int len[MAXSYMBOLS];
+    for (int i = 0; i < MAXSYMBOLS; i++)
+        len[i] = 0;
+    // An empty input without an end-of-stream symbol needs no codes at all
+    timer = STATBEGIN();
+    if (total > 0 || eos)
+    {
+        HUFFTREE ht = {NULL, 0, -1, 0, NULL};
+        huffmanLengths(counts, len, &ht, maxLen);
+        if (maxLen > 0)
+            reportLimit(counts, len, &ht, maxLen);
+        freeTree(&ht);
+    }
+    STATEND(STATTREE, timer, 0);
+    uint64_t coded = encPackedFile(len, NULL, input, output, interval);
+    if (samples > 0 && total > 0)
+    {
+        // The samples stand for the whole file, the added counts don't
+        uint64_t estimate = 0;
+        for (int i = 0; i < SYMBOLS; i++)
+            estimate += (counts[i] - (sampled < total)) * (uint64_t)len[i];
+        double bits = (double)estimate / (double)sampled;
+        double actual = (double)(coded - (uint64_t)len[EOS]) / (double)total;
+        printf("Sampled %lld of %lld bytes: estimated %.4f bits per byte, actual %.4f (%+.3f%%)\n", sampled, total,
+               bits, actual, 100.0 * (actual - bits) / bits);
+    }
+}
+
+void decompPackedRange(char *input, char *output, uint64_t from, uint64_t to)
+{
+    double timer = STATBEGIN();
+    FILE *fp1 = fopen(input, "rb");
+    if (fp1 == NULL)
+    {
+        perror("Error opening input file");
+        exit(EXIT_FAILURE);
+    }
+    int len[MAXSYMBOLS];
+    uint64_t n;
+    int flags = readHeader(fp1, input, len, &n);
+    long start = ftell(fp1);
+    if (to > n)
+        to = n;
+    if (from > to)
+    {
+        printf("Error: %s has only %llu characters\n", input, (unsigned long long)n);
+        exit(EXIT_FAILURE);
+    }
+    DECODETABLE dt;
+    if (tableFromLengths(&dt, len, MAXSYMBOLS) == -1)
+    {
+        printf("Error: Packed file header is corrupted\n");
+        exit(EXIT_FAILURE);
+    }
+    // Without an index the decoding starts at the first character
+    uint64_t skip = from;
+    uint64_t bit = 0;
+    if (flags & PACKEDINDEX)
+    {
+        char magic[4];
+        fseek(fp1, -16, SEEK_END);
+        uint64_t entries = readU64(fp1);
+        uint32_t interval = readU32(fp1);
+        if (fread(magic, 1, 4, fp1) != 4 || memcmp(magic, PACKEDINDEXMAGIC, 4) != 0 || interval == 0)
+        {
+            printf("Error: %s has a corrupted index\n", input);
+            exit(EXIT_FAILURE);
+        }
+        uint64_t entry = from / interval;
+        if (entry < entries)
+        {
+            if (fseek(fp1, -16 - (long)(8 * (entries - entry)), SEEK_END) != 0)
+            {
+                printf("Error: %s has a corrupted index\n", input);
+                exit(EXIT_FAILURE);
+            }
+            bit = readU64(fp1);
+            skip = from - entry * interval;
+        }
+    }
+    fseek(fp1, start + (long)(bit / 8), SEEK_SET);
+    BITREADER br;
+    openReader(&br, fp1);
+    uint64_t unused;
+    if (bit % 8 != 0)
+        readBits(&br, (int)(bit % 8), &unused);
+    FILE *fp2 = fopen(output, "wb");
+    if (fp2 == NULL)
+    {
+        perror("Error opening output file");
+        fclose(fp1);
+        exit(EXIT_FAILURE);
+    }
+    unsigned char *buf = (unsigned char *)malloc(PACKEDOUT);
+    if (buf == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    size_t used = 0;
+    for (uint64_t k = from - skip; k < to; k++)
+    {
+        int c = decodeSymbol(&dt, &br);
+        if (c < 0 || c >= SYMBOLS)
+        {
+            printf("Error: %s is truncated or corrupted\n", input);
+            exit(EXIT_FAILURE);
+        }
+        if (k < from)
+            continue;
+        buf[used++] = (unsigned char)c;
+        if (used == PACKEDOUT)
+        {
+            fwrite(buf, 1, used, fp2);
+            used = 0;
+        }
+    }
+    fwrite(buf, 1, used, fp2);
+    freeTable(&dt);
+    closeReader(&br);
+    free(buf);
+    fclose(fp1);
+    if (fclose(fp2) != 0)
+    {
+        perror("Error writing output file");
+        exit(EXIT_FAILURE);
+    }
+    STATEND(STATDECODE, timer, to - from);
+}
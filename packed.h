@@ -0,0 +1,136 @@
+/**
+ * @file packed.h
+ * @brief Packed binary container for Huffman encoded files.
+ *
+ * The packed format replaces the textual '0'/'1' output of printEncFile with
+ * a real bitstream. A packed file consists of:
+ *
+ * - a 4 byte magic "HUFP" and a 1 byte format version,
+ * - a 1 byte flags field (PACKEDEOS if the end-of-stream symbol is used,
+ *   PACKEDINDEX if the file ends with an index),
+ * - the original length in bytes as a 64-bit big-endian integer,
+ * - 256 bytes with the code length of every byte value (0 if it has no code),
+ *   followed by the code length of the end-of-stream symbol if it is used,
+ * - the bitstream: the code of every input byte, then the code of the
+ *   end-of-stream symbol if it is used, packed MSB-first into 64-bit words,
+ * - optionally, the index: the bit offset into the bitstream of every
+ *   interval-th character as 64-bit big-endian integers, then the number of
+ *   entries as a 64-bit integer, the interval as a 32-bit integer and the
+ *   4 byte magic "HUFI". Since the index is at the end, a range of
+ *   characters decodes by reading one entry and at most interval - 1
+ *   characters before the range.
+ *
+ * The codes are canonical (see canonical.h), so the lengths are all the
+ * decoder needs to rebuild them.
+ *
+ * The textual format is still available through the `-t` option. Since the
+ * header carries the code lengths, a packed file can be decompressed without
+ * the probability file it was encoded with (`-c` and `-x` options).
+ *
+ * @see bitio.h
+ * @see canonical.h
+ */
+
+#include "bitio.h"
+#include "canonical.h"
+#include "model.h"
+
+#ifndef PACKEDH
+#define PACKEDH
+
+/** Magic bytes at the start of every packed file. */
+#define PACKEDMAGIC "HUFP"
+
+/** Current version of the packed format. */
+#define PACKEDVERSION 3
+
+/** Flag set when the stream is terminated by the end-of-stream symbol. */
+#define PACKEDEOS 0x01
+
+/** Flag set when the file ends with an index of bit offsets. */
+#define PACKEDINDEX 0x02
+
+/** Magic bytes at the end of the index. */
+#define PACKEDINDEXMAGIC "HUFI"
+
+/**
+ * @brief Encodes a file into the packed format.
+ *
+ * Reads the input file, writes the header and the code lengths and then the
+ * canonical code of every byte through a bit writer. If the end-of-stream
+ * symbol has a code, it is written after the last byte. With an interval,
+ * the bit offset of every interval-th byte is written to the index.
+ *
+ * With a compiled model its codes and encoding table are used instead of
+ * being built from the code lengths.
+ *
+ * @param len Code lengths created by huffmanT, ignored with a model.
+ * @param model Compiled model (see model.h), or NULL.
+ * @param input Input file name.
+ * @param output Output file name.
+ * @param interval Bytes between two index entries, 0 for no index.
+ * @return Number of bits in the bitstream, without the padding.
+ */
+uint64_t encPackedFile(int *, CODEMODEL *, char *, char *, uint32_t);
+
+/**
+ * @brief Decompresses a packed file.
+ *
+ * Checks the header, makes sure the stored code lengths match the ones that
+ * were built from the probability file and then decodes with a lookup table
+ * (see lookup.h) until the end-of-stream symbol, if it is used, or until
+ * as many bytes as the header says.
+ *
+ * If no code lengths are given, the ones stored in the header are used as
+ * they are, so the file decompresses without a probability file. With a
+ * compiled model the stored lengths are checked against its lengths and its
+ * decoding table, possibly mapped from the model file, is used instead of
+ * building one.
+ *
+ * @param input Packed input file name.
+ * @param output Decompressed output file name.
+ * @param len Code lengths created by huffmanT, or NULL.
+ * @param model Compiled model (see model.h), or NULL.
+ * @return void
+ */
+void decompPackedFile(char *, char *, int *, CODEMODEL *);
+
+/**
+ * @brief Compresses a file in a single pass over the model.
+ *
+ * Counts the bytes of the input with an integer histogram, builds the code
+ * lengths from the counts and writes a self-describing packed file. No
+ * probability file or "codes.txt" is read or written.
+ *
+ * With samples, the counts are estimated from that many evenly spaced
+ * blocks (see sampleFile in histogram.h) instead of a full pass over the
+ * input, and the estimated and the actual bits per byte are printed after
+ * encoding.
+ *
+ * @param input Input file name.
+ * @param output Packed output file name.
+ * @param eos 1 to terminate the stream with the end-of-stream symbol.
+ * @param maxLen Longest allowed code length, 0 for no limit.
+ * @param interval Bytes between two index entries, 0 for no index.
+ * @param samples Number of blocks to sample, 0 to count the whole input.
+ * @return void
+ */
+void compressFile(char *, char *, int, int, uint32_t, int);
+
+/**
+ * @brief Decompresses the characters [from, to) of a packed file.
+ *
+ * With an index, decoding starts at the last index entry before `from`,
+ * so the time depends on the size of the range and not on its position.
+ * Without one, it starts at the first character. `to` is capped at the
+ * length of the file.
+ *
+ * @param input Packed input file name.
+ * @param output Output file name.
+ * @param from First character to decode.
+ * @param to Character after the last one to decode.
+ * @return void
+ */
+void decompPackedRange(char *, char *, uint64_t, uint64_t);
+
+#endif
@@ -0,0 +1,160 @@
+#include "pool.h"
+
+int cpuCount(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+// Runs jobs of the current round until none is left; called with the lock held
+static void runJobs(THREADPOOL *pool)
+{
+    while (pool->next < pool->n)
+    {
+        int job = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        pool->fn(pool->ctx, job);
+        pthread_mutex_lock(&pool->lock);
+        if (++pool->finished == pool->n)
+            pthread_cond_broadcast(&pool->done);
+    }
+}
+
+static void *worker(void *arg)
+{
+    THREADPOOL *pool = (THREADPOOL *)arg;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        while (!pool->stop && pool->round == seen)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->stop)
+            break;
+        seen = pool->round;
+        runJobs(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+void createPool(THREADPOOL *pool, int threads)
+{
+    if (threads <= 0)
+        threads = cpuCount();
+    pool->threads = threads - 1;
+    pool->n = 0;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->round = 0;
+    pool->stop = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->tid = (pthread_t *)malloc((pool->threads + 1) * sizeof(pthread_t));
+    if (pool->tid == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < pool->threads; i++)
+    {
+        if (pthread_create(&pool->tid[i], NULL, worker, pool) != 0)
+        {
+            perror("Error creating thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void runPool(THREADPOOL *pool, int n, void (*fn)(void *, int), void *ctx)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->n = n;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->round++;
+    pthread_cond_broadcast(&pool->start);
+    runJobs(pool);
+    while (pool->finished < pool->n)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void destroyPool(THREADPOOL *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->threads; i++)
+        pthread_join(pool->tid[i], NULL);
+    free(pool->tid);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+}
+
+static void *stageWorker(void *arg)
+{
+    STAGE *stage = (STAGE *)arg;
+    pthread_mutex_lock(&stage->lock);
+    while (1)
+    {
+        while (!stage->stop && !stage->busy)
+            pthread_cond_wait(&stage->cond, &stage->lock);
+        if (stage->stop)
+            break;
+        pthread_mutex_unlock(&stage->lock);
+        stage->fn(stage->arg);
+        pthread_mutex_lock(&stage->lock);
+        stage->busy = 0;
+        pthread_cond_broadcast(&stage->cond);
+    }
+    pthread_mutex_unlock(&stage->lock);
+    return NULL;
+}
+
+void createStage(STAGE *stage)
+{
+    stage->busy = 0;
+    stage->stop = 0;
+    pthread_mutex_init(&stage->lock, NULL);
+    pthread_cond_init(&stage->cond, NULL);
+    if (pthread_create(&stage->tid, NULL, stageWorker, stage) != 0)
+    {
+        perror("Error creating thread");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void startStage(STAGE *stage, void (*fn)(void *), void *arg)
+{
+    pthread_mutex_lock(&stage->lock);
+    stage->fn = fn;
+    stage->arg = arg;
+    stage->busy = 1;
+    pthread_cond_broadcast(&stage->cond);
+    pthread_mutex_unlock(&stage->lock);
+}
+
+void waitStage(STAGE *stage)
+{
+    pthread_mutex_lock(&stage->lock);
+    while (stage->busy)
+        pthread_cond_wait(&stage->cond, &stage->lock);
+    pthread_mutex_unlock(&stage->lock);
+}
+
+void destroyStage(STAGE *stage)
+{
+    pthread_mutex_lock(&stage->lock);
+    stage->stop = 1;
+    pthread_cond_broadcast(&stage->cond);
+    pthread_mutex_unlock(&stage->lock);
+    pthread_join(stage->tid, NULL);
+    pthread_mutex_destroy(&stage->lock);
+    pthread_cond_destroy(&stage->cond);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file pool.h
+ * @brief A small pthread thread pool for running independent jobs.
+ *
+ * The pool keeps its worker threads alive between calls. runPool hands out
+ * job numbers 0..n-1 to the workers and to the calling thread, and returns
+ * once every job is finished, so a caller can run one round of block jobs
+ * after another without creating threads each time.
+ *
+ * A STAGE is a single background thread that runs one task at a time while
+ * the caller does something else, like writing out the last round of blocks
+ * and reading the next one while the pool codes the current round.
+ *
+ * @see block.h
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef POOLH
+#define POOLH
+
+/**
+ * @struct THREADPOOL
+ * @brief State shared by the threads of a pool.
+ */
+typedef struct ThreadPool
+{
+    pthread_t *tid;         /**< Worker threads */
+    int threads;            /**< Number of worker threads */
+    pthread_mutex_t lock;   /**< Protects everything below */
+    pthread_cond_t start;   /**< Signalled when a new round of jobs starts */
+    pthread_cond_t done;    /**< Signalled when the last job of a round ends */
+    void (*fn)(void *, int); /**< Job function of the current round */
+    void *ctx;              /**< Argument passed to the job function */
+    int n;                  /**< Number of jobs in the current round */
+    int next;               /**< Next job to hand out */
+    int finished;           /**< Number of finished jobs */
+    unsigned long round;    /**< Round counter, so workers notice new rounds */
+    int stop;               /**< Set to make the workers exit */
+} THREADPOOL;
+
+/**
+ * @struct STAGE
+ * @brief A background thread that runs one task at a time.
+ */
+typedef struct Stage
+{
+    pthread_t tid;         /**< Background thread */
+    pthread_mutex_t lock;  /**< Protects everything below */
+    pthread_cond_t cond;   /**< Signalled when a task starts or ends */
+    void (*fn)(void *);    /**< Current task */
+    void *arg;             /**< Argument passed to the task */
+    int busy;              /**< Set while a task is started and not finished */
+    int stop;              /**< Set to make the thread exit */
+} STAGE;
+
+/**
+ * @brief Returns the number of online CPUs, at least 1.
+ *
+ * @return Number of CPUs.
+ */
+int cpuCount(void);
+
+/**
+ * @brief Creates a pool that runs jobs on the given number of threads.
+ *
+ * The calling thread counts as one of them, so threads-1 workers are
+ * started.
+ *
+ * @param pool Pool to initialize.
+ * @param threads Number of threads, 0 for one per CPU.
+ * @return void
+ */
+void createPool(THREADPOOL *, int);
+
+/**
+ * @brief Runs fn(ctx, i) for every i in 0..n-1 and waits for all of them.
+ *
+ * @param pool Thread pool.
+ * @param n Number of jobs.
+ * @param fn Job function.
+ * @param ctx Argument passed to every job.
+ * @return void
+ */
+void runPool(THREADPOOL *, int, void (*)(void *, int), void *);
+
+/**
+ * @brief Stops and joins the worker threads of a pool.
+ *
+ * @param pool Thread pool.
+ * @return void
+ */
+void destroyPool(THREADPOOL *);
+
+/**
+ * @brief Starts the background thread of a stage.
+ *
+ * @param stage Stage to initialize.
+ * @return void
+ */
+void createStage(STAGE *);
+
+/**
+ * @brief Runs fn(arg) on the background thread and returns right away.
+ *
+ * The previous task must have been waited for.
+ *
+ * @param stage Stage.
+ * @param fn Task function.
+ * @param arg Argument passed to the task.
+ * @return void
+ */
+void startStage(STAGE *, void (*)(void *), void *);
+
+/**
+ * @brief Waits until the task started last is finished.
+ *
+ * @param stage Stage.
+ * @return void
+ */
+void waitStage(STAGE *);
+
+/**
+ * @brief Stops and joins the background thread of a stage.
+ *
+ * @param stage Stage, with no task running.
+ * @return void
+ */
+void destroyStage(STAGE *);
+
+#endif
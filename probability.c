@@ -0,0 +1,158 @@
+// stat is POSIX, not C99
+#define _XOPEN_SOURCE 600
+
+#include "probability.h"
+#include "canonical.h"
+#include "histogram.h"
+#include "stats.h"
+#include <sys/stat.h>
+
+/**
+ * @struct CACHEENTRY
+ * @brief A model in the cache and what it was made from.
+ */
+typedef struct CacheEntry
+{
+    char *path;    /**< Name of the file the model came from */
+    off_t size;    /**< Size of the file when the model was made */
+    time_t mtime;  /**< Modification time of the file then */
+    int eos;       /**< eos it was asked for with */
+    int maxLen;    /**< maxLen it was asked for with */
+    CODEMODEL *m;  /**< The model, NULL if the entry is free */
+} CACHEENTRY;
+
+static CACHEENTRY cache[MODELCACHE];
+static int cacheNext = 0;
+
+void probFile(char *filename, char *filenameOut, float *f)
+{
+    uint64_t counts[SYMBOLS];
+    for (int i = 0; i < SYMBOLS; i++)
+        counts[i] = 0;
+    long long count = histFile(filename, counts);
+    if (count == -1)
+    {
+        printf("Error reading file: %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < SYMBOLS; i++)
+        f[i] = count > 0 ? (float)((double)counts[i] / (double)count) : 0;
+    printF(f, filenameOut, SYMBOLS);
+}
+
+int huffmanT(float *f, char **codes, int *len, HUFFTREE *ht, int maxLen)
+{
+    double timer = STATBEGIN();
+    uint64_t w[MAXSYMBOLS];
+    probWeights(f, w, MAXSYMBOLS);
+    int count = huffmanLengths(w, len, ht, maxLen);
+    if (maxLen > 0)
+        reportLimit(w, len, ht, maxLen);
+    uint64_t bits[MAXSYMBOLS];
+    canonicalCodes(len, bits, MAXSYMBOLS);
+    codeStrings(len, bits, codes, MAXSYMBOLS, ht);
+    STATEND(STATTREE, timer, 0);
+    timer = STATBEGIN();
+    // print codes
+    for (int i = 32; i < 127; i++)
+    {
+        printf("%c :", (char)i);
+        if (codes[i] == NULL)
+            printf("No code\n");
+        else
+            printf("%s\n", codes[i]);
+    }
+    printFCode(codes, "codes.txt", SYMBOLS);
+    STATEND(STATCODES, timer, statFileSize("codes.txt"));
+    return count;
+}
+
+void buildModel(CODEMODEL *m, char *prob, int eos, int maxLen)
+{
+    uint64_t hash;
+    if (hashFile(prob, &hash) == -1)
+    {
+        perror("Error opening probability file");
+        exit(EXIT_FAILURE);
+    }
+    float f[MAXSYMBOLS];
+    for (int i = 0; i < MAXSYMBOLS; i++)
+        f[i] = 0.0;
+    readProb(prob, f);
+    if (eos)
+        addEOS(f);
+    uint64_t w[MAXSYMBOLS];
+    probWeights(f, w, MAXSYMBOLS);
+    modelFromCounts(m, w, maxLen);
+    m->hash = hash;
+    m->eos = eos;
+}
+
+CODEMODEL *cachedModel(char *filename, int eos, int maxLen)
+{
+    // The file is only read again if its name, size or time changed
+    struct stat st;
+    if (stat(filename, &st) != 0)
+    {
+        perror("Error opening probability file");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < MODELCACHE; i++)
+        if (cache[i].m != NULL && strcmp(cache[i].path, filename) == 0 && cache[i].size == st.st_size &&
+            cache[i].mtime == st.st_mtime && cache[i].eos == eos && cache[i].maxLen == maxLen)
+            return cache[i].m;
+    CACHEENTRY *c = &cache[cacheNext];
+    cacheNext = (cacheNext + 1) % MODELCACHE;
+    if (c->m == NULL)
+    {
+        c->m = (CODEMODEL *)malloc(sizeof(CODEMODEL));
+        if (c->m == NULL)
+        {
+            perror("Memory allocation failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
+    {
+        freeModel(c->m);
+        free(c->path);
+    }
+    c->path = (char *)malloc(strlen(filename) + 1);
+    if (c->path == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    strcpy(c->path, filename);
+    if (fileMagic(filename, MODELMAGIC))
+    {
+        if (loadModel(c->m, filename) == -1)
+        {
+            printf("Error: %s is not a valid model file\n", filename);
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
+        buildModel(c->m, filename, eos, maxLen);
+    c->size = st.st_size;
+    c->mtime = st.st_mtime;
+    c->eos = eos;
+    c->maxLen = maxLen;
+    return c->m;
+}
+
+void freeModelCache(void)
+{
+    for (int i = 0; i < MODELCACHE; i++)
+    {
+        if (cache[i].m != NULL)
+        {
+            freeModel(cache[i].m);
+            free(cache[i].m);
+            free(cache[i].path);
+            cache[i].m = NULL;
+            cache[i].path = NULL;
+        }
+    }
+    cacheNext = 0;
+}
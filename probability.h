@@ -0,0 +1,91 @@
+/**
+ * @file probability.h
+ * @brief Codes and models built from probability files.
+ *
+ * Everything that reads or writes the text files of the command line lives
+ * here: writing a probability file, building the codes of `-s` and writing
+ * "codes.txt", building models from probability files and the small
+ * in-process cache of models. The rest of the library works on counts,
+ * code lengths and models and doesn't need file.h, so it can be linked into
+ * programs like the benchmarks without it.
+ *
+ * @see huffmanTree.h
+ * @see model.h
+ * @see file.h
+ */
+
+#include "huffmanTree.h"
+#include "model.h"
+
+#ifndef PROBABILITYH
+#define PROBABILITYH
+
+/** Number of models kept by cachedModel. */
+#define MODELCACHE 8
+
+/**
+ * @brief Generates a Huffman tree based on the given frequencies.
+ *
+ * This function firstly, turns the frequencies into integer weights and
+ * then using buildTree it creates a binary tree for the characters.
+ * Then it takes the code length of each character from the tree and
+ * assigns canonical codes (see canonical.h), which it stores in an array
+ * code. The strings of the codes belong to the tree and are freed with it.
+ * Lastly, it prints the codes.
+ *
+ * @param f Array of frequencies.
+ * @param codes Array to store Huffman codes.
+ * @param len Array to store the code lengths.
+ * @param ht Huffman tree.
+ * @param maxLen Longest allowed code length, 0 for no limit.
+ * @return Index of the root node in the array.
+ */
+int huffmanT(float *, char **, int *, HUFFTREE *, int);
+
+/**
+ * @brief Reads the frequencies from a file and generates a probability file.
+ *
+ * Counts the bytes of a given file with an integer histogram (see
+ * histogram.h), generates the probability and prints it to a new file.
+ *
+ * @param filename Input file.
+ * @param filenameOut Output file.
+ * @param f Array to store frequencies.
+ * @return void
+ */
+void probFile(char *, char *, float *);
+
+/**
+ * @brief Builds a model from a probability file.
+ *
+ * @param m Model to build.
+ * @param prob Probability file name.
+ * @param eos 1 to add an end-of-stream symbol.
+ * @param maxLen Longest allowed code length, 0 for no limit.
+ * @return void
+ */
+void buildModel(CODEMODEL *, char *, int, int);
+
+/**
+ * @brief Gets the model of a model file or a probability file from the cache.
+ *
+ * The model is looked up by file name, size and modification time, eos and
+ * maxLen, so a hit costs a stat call; only on a miss is the file read and
+ * the model loaded or built, replacing the oldest model in the cache. The model stays valid until MODELCACHE other models
+ * have been added or freeModelCache is called.
+ *
+ * @param filename Model file or probability file name.
+ * @param eos 1 to add an end-of-stream symbol (probability files only).
+ * @param maxLen Longest allowed code length (probability files only).
+ * @return The model.
+ */
+CODEMODEL *cachedModel(char *, int, int);
+
+/**
+ * @brief Frees every model in the cache.
+ *
+ * @return void
+ */
+void freeModelCache(void);
+
+#endif
@@ -0,0 +1,118 @@
+// clock_gettime, stat and getrusage are POSIX, not C99
+#define _XOPEN_SOURCE 600
+
+#include "stats.h"
+#include "histogram.h"
+#include "cpu.h"
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+int statsMode = STATSOFF;
+
+static const char *stageNames[STATSTAGES] = {"parse", "histogram", "tree", "codes", "encode", "decode"};
+
+static STATSTAGE stages[STATSTAGES];
+
+// Byte counts of all coded files, the bits they were coded in and how many
+// of those were codes
+static uint64_t codedCounts[SYMBOLS];
+static uint64_t codedBits;
+static uint64_t payloadBits;
+
+// Payload of the file being coded, until statCoding adds it
+static uint64_t pendingBits;
+
+double statNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+void statAdd(int stage, double start, uint64_t bytes)
+{
+    stages[stage].calls++;
+    stages[stage].seconds += statNow() - start;
+    stages[stage].bytes += bytes;
+}
+
+uint64_t statFileSize(char *filename)
+{
+    struct stat st;
+    if (strcmp(filename, "-") == 0 || stat(filename, &st) != 0)
+        return 0;
+    return (uint64_t)st.st_size;
+}
+
+void statPayload(uint64_t bits)
+{
+    pendingBits += bits;
+}
+
+void statCoding(char *plain, char *coded, int text)
+{
+    uint64_t payload = pendingBits;
+    pendingBits = 0;
+    if (statsMode == STATSOFF || strcmp(plain, "-") == 0 || strcmp(coded, "-") == 0)
+        return;
+    if (histFile(plain, codedCounts) == -1)
+        return;
+    uint64_t size = statFileSize(coded);
+    codedBits += text ? size : size * 8;
+    payloadBits += text ? size : payload;
+}
+
+void statsReport(void)
+{
+    if (statsMode == STATSOFF)
+        return;
+    uint64_t symbols = 0;
+    for (int i = 0; i < SYMBOLS; i++)
+        symbols += codedCounts[i];
+    double entropy = 0;
+    for (int i = 0; i < SYMBOLS; i++)
+    {
+        if (codedCounts[i] > 0)
+        {
+            double p = (double)codedCounts[i] / (double)symbols;
+            entropy -= p * log2(p);
+        }
+    }
+    double achieved = symbols > 0 ? (double)payloadBits / (double)symbols : 0;
+    double total = symbols > 0 ? (double)codedBits / (double)symbols : 0;
+    uint64_t overhead = codedBits > payloadBits ? (codedBits - payloadBits) / 8 : 0;
+    struct rusage ru;
+    long peak = getrusage(RUSAGE_SELF, &ru) == 0 ? ru.ru_maxrss : 0;
+    if (statsMode == STATSJSON)
+    {
+        fprintf(stderr, "{\"stages\": {");
+        for (int s = 0; s < STATSTAGES; s++)
+            fprintf(stderr, "%s\"%s\": {\"calls\": %d, \"seconds\": %.6f, \"bytes\": %llu}", s > 0 ? ", " : "",
+                    stageNames[s], stages[s].calls, stages[s].seconds, (unsigned long long)stages[s].bytes);
+        fprintf(stderr,
+                "}, \"symbols\": %llu, \"entropy\": %.4f, \"achieved\": %.4f, \"overhead_bytes\": %llu, "
+                "\"total\": %.4f, \"peak_kib\": %ld, \"kernels\": \"%s\"}\n",
+                (unsigned long long)symbols, entropy, achieved, (unsigned long long)overhead, total, peak,
+                cpuKernels());
+        return;
+    }
+    fprintf(stderr, "%-10s %6s %12s %14s %10s\n", "stage", "calls", "seconds", "bytes", "MB/s");
+    for (int s = 0; s < STATSTAGES; s++)
+    {
+        if (stages[s].calls == 0)
+            continue;
+        double rate = stages[s].seconds > 0 ? (double)stages[s].bytes / stages[s].seconds / 1e6 : 0;
+        fprintf(stderr, "%-10s %6d %12.6f %14llu %10.2f\n", stageNames[s], stages[s].calls, stages[s].seconds,
+                (unsigned long long)stages[s].bytes, rate);
+    }
+    if (symbols > 0)
+    {
+        fprintf(stderr, "entropy %.4f bits/symbol, achieved %.4f bits/symbol over %llu symbols\n", entropy, achieved,
+                (unsigned long long)symbols);
+        fprintf(stderr, "container overhead %llu bytes, %.4f bits/symbol in total\n", (unsigned long long)overhead,
+                total);
+    }
+    fprintf(stderr, "peak memory %ld KiB\n", peak);
+    fprintf(stderr, "kernels %s\n", cpuKernels());
+}
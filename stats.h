@@ -0,0 +1,141 @@
+/**
+ * @file stats.h
+ * @brief Per-stage timers and counters reported by `--stats`.
+ *
+ * Every stage of a run (parsing the probability file, counting bytes,
+ * building the tree, writing the codes, encoding and decoding) is timed
+ * with a monotonic clock and counts the bytes it processed. The coded files
+ * are also compared to the order-0 entropy of their bytes: the coders count
+ * the bits of the codes they write or read (the payload), and the rest of a
+ * coded file, its header, tables, index and padding, is reported apart as
+ * container overhead. At the end of
+ * the run statsReport prints the totals, the peak memory and the CPU
+ * features the kernels used (see cpu.h) to stderr, as plain text or JSON.
+ *
+ * Statistics are off unless `--stats` is given. Then STATBEGIN and STATEND
+ * cost a single branch per stage, and nothing is counted per byte.
+ *
+ * @see argument.h
+ */
+
+#include <stdint.h>
+#include "huffmanTree.h"
+
+#ifndef STATSH
+#define STATSH
+
+/** Statistics are not collected. */
+#define STATSOFF 0
+
+/** Statistics are reported as plain text. */
+#define STATSTEXT 1
+
+/** Statistics are reported as JSON. */
+#define STATSJSON 2
+
+/** Stages that are timed. */
+enum
+{
+    STATPARSE,     /**< Reading a probability or model file */
+    STATHISTOGRAM, /**< Counting the bytes of a file */
+    STATTREE,      /**< Building the tree and the codes */
+    STATCODES,     /**< Printing the codes and writing "codes.txt" */
+    STATENCODE,    /**< Encoding */
+    STATDECODE,    /**< Decoding */
+    STATSTAGES     /**< Number of stages */
+};
+
+/**
+ * @struct STATSTAGE
+ * @brief Totals of one stage.
+ */
+typedef struct StatStage
+{
+    int calls;      /**< Number of times the stage ran */
+    double seconds; /**< Total time spent in the stage */
+    uint64_t bytes; /**< Total number of bytes the stage processed */
+} STATSTAGE;
+
+/** STATSOFF, STATSTEXT or STATSJSON. */
+extern int statsMode;
+
+/** Starts timing a stage, 0 if statistics are off. */
+#define STATBEGIN() (statsMode != STATSOFF ? statNow() : 0.0)
+
+/** Adds the time since STATBEGIN and a number of bytes to a stage. */
+#define STATEND(stage, start, bytes)              \
+    do                                            \
+    {                                             \
+        if (statsMode != STATSOFF)                \
+            statAdd((stage), (start), (bytes));   \
+    } while (0)
+
+/** Adds bits of codes to the payload of the file being coded. */
+#define STATPAYLOAD(bits)                         \
+    do                                            \
+    {                                             \
+        if (statsMode != STATSOFF)                \
+            statPayload(bits);                    \
+    } while (0)
+
+/**
+ * @brief Reads the monotonic clock.
+ *
+ * @return Seconds since an arbitrary point.
+ */
+double statNow(void);
+
+/**
+ * @brief Adds a run of a stage.
+ *
+ * @param stage Stage, one of STATPARSE to STATDECODE.
+ * @param start Time returned by STATBEGIN.
+ * @param bytes Number of bytes processed.
+ * @return void
+ */
+void statAdd(int, double, uint64_t);
+
+/**
+ * @brief Finds the size of a file.
+ *
+ * @param filename File name.
+ * @return Size in bytes, 0 for "-" or a file that doesn't exist.
+ */
+uint64_t statFileSize(char *);
+
+/**
+ * @brief Adds bits of codes to the payload of the file being coded.
+ *
+ * The payload is kept until statCoding adds the file to the totals.
+ *
+ * @param bits Number of bits.
+ * @return void
+ */
+void statPayload(uint64_t);
+
+/**
+ * @brief Adds a coded file to the entropy and bits per symbol totals.
+ *
+ * Counts the bytes of the uncoded file for its entropy, and splits the size
+ * of the coded file into the payload added with statPayload since the last
+ * call and the container overhead. The textual format has no container, so
+ * all of it is payload. Does nothing if statistics are off or one of the
+ * files is stdin or stdout.
+ *
+ * @param plain Uncoded file name.
+ * @param coded Coded file name.
+ * @param text 1 if the coded file is in the textual format, one character per bit.
+ * @return void
+ */
+void statCoding(char *, char *, int);
+
+/**
+ * @brief Prints all statistics to stderr.
+ *
+ * Does nothing if statistics are off.
+ *
+ * @return void
+ */
+void statsReport(void);
+
+#endif
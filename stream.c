@@ -0,0 +1,318 @@
+#include "stream.h"
+#include "stats.h"
+
+// Size of the buffers used by compressStream and decompressStream
+#define STREAMIO (1 << 16)
+
+enum
+{
+    ENCDRAIN,  // writing out head and the coded block
+    ENCGATHER, // collecting input for the next block
+    ENCEND,    // writing out the end marker
+    ENCDONE,
+    DECMAGIC,  // reading the magic and version
+    DECSIZE,   // reading the uncompressed size of a block
+    DECCODED,  // reading the compressed size of a block
+    DECGATHER, // collecting the compressed block
+    DECDRAIN,  // writing out the decoded block
+    DECDONE
+};
+
+static void putU32(unsigned char *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (unsigned char)(v >> (24 - 8 * i));
+}
+
+static uint32_t getU32(unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static size_t copyOut(unsigned char *out, size_t cap, const unsigned char *from, size_t *pos, size_t len)
+{
+    size_t n = len - *pos < cap ? len - *pos : cap;
+    // from is NULL before the first block is coded
+    if (n == 0)
+        return 0;
+    memcpy(out, from + *pos, n);
+    *pos += n;
+    return n;
+}
+
+void streamInit(HUFFSTREAM *s, int decode)
+{
+    s->decode = decode;
+    s->job.raw = (unsigned char *)malloc(STREAMBLOCK);
+    if (s->job.raw == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    s->job.rawLen = 0;
+    s->job.coded = NULL;
+    s->job.codedLen = 0;
+    s->job.codedCap = 0;
+    s->job.work = NULL;
+    s->job.workCap = 0;
+    s->job.ready = NULL;
+    s->job.tree = (HUFFTREE){NULL, 0, -1, 0, NULL};
+    s->pos = 0;
+    s->headPos = 0;
+    if (decode)
+    {
+        s->state = DECMAGIC;
+        s->headLen = 5;
+        return;
+    }
+    memcpy(s->head, STREAMMAGIC, 4);
+    s->head[4] = STREAMVERSION;
+    s->headLen = 5;
+    s->state = ENCDRAIN;
+}
+
+// Writes out what is left of head and the coded block, returns 1 when done
+static int drainEncoder(HUFFSTREAM *s, unsigned char *out, size_t cap, size_t *made)
+{
+    size_t n = copyOut(out + *made, cap - *made, s->head, &s->headPos, s->headLen);
+    *made += n;
+    n = copyOut(out + *made, cap - *made, s->job.coded, &s->pos, s->job.codedLen);
+    *made += n;
+    return s->headPos == s->headLen && s->pos == s->job.codedLen;
+}
+
+static void startBlock(HUFFSTREAM *s)
+{
+    encodeBlock(&s->job, NULL, NULL, 1, 0, 0);
+    STATPAYLOAD(s->job.payload);
+    putU32(s->head, (uint32_t)s->job.rawLen);
+    putU32(s->head + 4, (uint32_t)s->job.codedLen);
+    s->headLen = 8;
+    s->headPos = 0;
+    s->pos = 0;
+    s->state = ENCDRAIN;
+}
+
+static int decodeSome(HUFFSTREAM *s, const unsigned char *in, size_t inLen, size_t *used, unsigned char *out, size_t outCap, size_t *made)
+{
+    while (1)
+    {
+        if (s->state == DECDRAIN)
+        {
+            *made += copyOut(out + *made, outCap - *made, s->job.raw, &s->pos, s->job.rawLen);
+            if (s->pos < s->job.rawLen)
+                return 0;
+            s->state = DECSIZE;
+            s->headLen = 4;
+            s->headPos = 0;
+        }
+        if (s->state == DECDONE)
+            return *used < inLen ? -1 : 0;
+        if (*used == inLen)
+            return 0;
+        if (s->state == DECGATHER)
+        {
+            size_t n = s->job.codedLen - s->pos < inLen - *used ? s->job.codedLen - s->pos : inLen - *used;
+            memcpy(s->job.coded + s->pos, in + *used, n);
+            s->pos += n;
+            *used += n;
+            if (s->pos < s->job.codedLen)
+                continue;
+            if (decodeBlock(&s->job, NULL, 1, 0) == -1)
+                return -1;
+            STATPAYLOAD(s->job.payload);
+            s->state = DECDRAIN;
+            s->pos = 0;
+            continue;
+        }
+        // The other states read a header field into head first
+        size_t n = s->headLen - s->headPos < inLen - *used ? s->headLen - s->headPos : inLen - *used;
+        memcpy(s->head + s->headPos, in + *used, n);
+        s->headPos += n;
+        *used += n;
+        if (s->headPos < s->headLen)
+            continue;
+        s->headPos = 0;
+        if (s->state == DECMAGIC)
+        {
+            if (memcmp(s->head, STREAMMAGIC, 4) != 0 || s->head[4] != STREAMVERSION)
+                return -1;
+            s->state = DECSIZE;
+            s->headLen = 4;
+        }
+        else if (s->state == DECSIZE)
+        {
+            s->job.rawLen = getU32(s->head);
+            if (s->job.rawLen > STREAMBLOCK)
+                return -1;
+            s->state = s->job.rawLen == 0 ? DECDONE : DECCODED;
+        }
+        else
+        {
+            // A block holds 256 code lengths and at most 64 bits per byte
+            size_t codedLen = getU32(s->head);
+            if (codedLen < SYMBOLS || codedLen > SYMBOLS + 8 * s->job.rawLen + 8)
+                return -1;
+            if (codedLen > s->job.codedCap)
+            {
+                unsigned char *temp = (unsigned char *)realloc(s->job.coded, codedLen);
+                if (temp == NULL)
+                {
+                    perror("Memory allocation failed");
+                    exit(EXIT_FAILURE);
+                }
+                s->job.coded = temp;
+                s->job.codedCap = codedLen;
+            }
+            s->job.codedLen = codedLen;
+            s->pos = 0;
+            s->state = DECGATHER;
+        }
+    }
+}
+
+int streamUpdate(HUFFSTREAM *s, const unsigned char *in, size_t inLen, size_t *used, unsigned char *out, size_t outCap, size_t *made)
+{
+    *used = 0;
+    *made = 0;
+    if (s->decode)
+        return decodeSome(s, in, inLen, used, out, outCap, made);
+    while (1)
+    {
+        if (s->state == ENCDRAIN)
+        {
+            if (!drainEncoder(s, out, outCap, made))
+                return 0;
+            s->state = ENCGATHER;
+            s->job.rawLen = 0;
+        }
+        if (*used == inLen)
+            return 0;
+        size_t n = STREAMBLOCK - s->job.rawLen < inLen - *used ? STREAMBLOCK - s->job.rawLen : inLen - *used;
+        memcpy(s->job.raw + s->job.rawLen, in + *used, n);
+        s->job.rawLen += n;
+        *used += n;
+        if (s->job.rawLen == STREAMBLOCK)
+            startBlock(s);
+    }
+}
+
+int streamFinish(HUFFSTREAM *s, unsigned char *out, size_t outCap, size_t *made)
+{
+    *made = 0;
+    if (s->decode)
+    {
+        if (s->state == DECDRAIN)
+        {
+            *made += copyOut(out, outCap, s->job.raw, &s->pos, s->job.rawLen);
+            if (s->pos < s->job.rawLen)
+                return 0;
+            s->state = DECSIZE;
+        }
+        return s->state == DECDONE ? 1 : -1;
+    }
+    while (1)
+    {
+        if (s->state == ENCDRAIN)
+        {
+            if (!drainEncoder(s, out, outCap, made))
+                return 0;
+            s->state = ENCGATHER;
+            s->job.rawLen = 0;
+        }
+        if (s->state == ENCGATHER && s->job.rawLen > 0)
+        {
+            startBlock(s);
+            continue;
+        }
+        if (s->state == ENCGATHER)
+        {
+            putU32(s->head, 0);
+            s->headLen = 4;
+            s->headPos = 0;
+            s->job.codedLen = 0;
+            s->pos = 0;
+            s->state = ENCEND;
+        }
+        if (s->state == ENCEND)
+        {
+            if (!drainEncoder(s, out, outCap, made))
+                return 0;
+            s->state = ENCDONE;
+        }
+        return 1;
+    }
+}
+
+void streamEnd(HUFFSTREAM *s)
+{
+    free(s->job.raw);
+    free(s->job.coded);
+    free(s->job.work);
+    freeTree(&s->job.tree);
+    s->job.raw = NULL;
+    s->job.coded = NULL;
+    s->job.work = NULL;
+}
+
+static void writeAll(unsigned char *buf, size_t n, FILE *out)
+{
+    if (n > 0 && fwrite(buf, 1, n, out) != n)
+    {
+        perror("Error writing output file");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void runStream(FILE *in, FILE *out, int decode)
+{
+    unsigned char *ibuf = (unsigned char *)malloc(STREAMIO);
+    unsigned char *obuf = (unsigned char *)malloc(STREAMIO);
+    if (ibuf == NULL || obuf == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    HUFFSTREAM s;
+    streamInit(&s, decode);
+    size_t n, used, made;
+    while ((n = fread(ibuf, 1, STREAMIO, in)) > 0)
+    {
+        size_t off = 0;
+        while (off < n)
+        {
+            if (streamUpdate(&s, ibuf + off, n - off, &used, obuf, STREAMIO, &made) == -1)
+            {
+                fprintf(stderr, "Error: Input stream is corrupted\n");
+                exit(EXIT_FAILURE);
+            }
+            writeAll(obuf, made, out);
+            off += used;
+        }
+    }
+    int status;
+    do
+    {
+        status = streamFinish(&s, obuf, STREAMIO, &made);
+        writeAll(obuf, made, out);
+    } while (status == 0);
+    if (status == -1)
+    {
+        fprintf(stderr, "Error: Input stream is truncated\n");
+        exit(EXIT_FAILURE);
+    }
+    fflush(out);
+    streamEnd(&s);
+    free(ibuf);
+    free(obuf);
+}
+
+void compressStream(FILE *in, FILE *out)
+{
+    runStream(in, out, 0);
+}
+
+void decompressStream(FILE *in, FILE *out)
+{
+    runStream(in, out, 1);
+}
@@ -0,0 +1,129 @@
+/**
+ * @file stream.h
+ * @brief Streaming compression API for pipes, sockets and embedding.
+ *
+ * A HUFFSTREAM encodes or decodes data in pieces: the caller passes in
+ * whatever input it has and an output buffer of any size, and the stream
+ * consumes and produces as much as it can. Nothing is ever read from or
+ * written to a file by the stream itself, and it never holds more than one
+ * block (STREAMBLOCK bytes) of data, so memory use is bounded no matter how
+ * long the stream is.
+ *
+ * The stream format consists of:
+ *
+ * - a 4 byte magic "HUFS" and a 1 byte format version,
+ * - any number of blocks, each made of its uncompressed and compressed sizes
+ *   as 32-bit big-endian integers and the compressed block, which starts
+ *   with its own 256 code lengths (see encodeBlock in block.h),
+ * - an uncompressed size of 0, which marks the end of the stream.
+ *
+ * Typical use:
+ *
+ *     streamInit(&s, 0);
+ *     while (there is input)
+ *         streamUpdate(&s, in, inLen, &used, out, outCap, &made);
+ *     while (streamFinish(&s, out, outCap, &made) == 0)
+ *         ...
+ *     streamEnd(&s);
+ *
+ * @see block.h
+ */
+
+#include "block.h"
+
+#ifndef STREAMH
+#define STREAMH
+
+/** Magic bytes at the start of every stream. */
+#define STREAMMAGIC "HUFS"
+
+/** Current version of the stream format. */
+#define STREAMVERSION 1
+
+/** Largest number of uncompressed bytes in one block of a stream. */
+#define STREAMBLOCK BLOCKSIZE
+
+/**
+ * @struct HUFFSTREAM
+ * @brief State of a streaming encoder or decoder.
+ */
+typedef struct HuffStream
+{
+    int decode;              /**< 1 for a decoder, 0 for an encoder */
+    int state;               /**< Where the stream is in the format */
+    BLOCKJOB job;            /**< Block being gathered, coded or drained */
+    unsigned char head[16];  /**< Block header being written or read */
+    size_t headLen;          /**< Bytes in head */
+    size_t headPos;          /**< Bytes of head already written or needed */
+    size_t pos;              /**< Bytes of the block already moved */
+} HUFFSTREAM;
+
+/**
+ * @brief Initializes a streaming encoder or decoder.
+ *
+ * @param s Stream to initialize.
+ * @param decode 1 for a decoder, 0 for an encoder.
+ * @return void
+ */
+void streamInit(HUFFSTREAM *, int);
+
+/**
+ * @brief Feeds input to a stream and collects output.
+ *
+ * Consumes input until it runs out or the output buffer is full. Input
+ * that was not consumed must be passed again in the next call.
+ *
+ * @param s Stream.
+ * @param in Input bytes.
+ * @param inLen Number of input bytes.
+ * @param used Pointer to store the number of input bytes consumed.
+ * @param out Output buffer.
+ * @param outCap Size of the output buffer.
+ * @param made Pointer to store the number of output bytes produced.
+ * @return 0 on success, -1 if the input of a decoder is corrupted.
+ */
+int streamUpdate(HUFFSTREAM *, const unsigned char *, size_t, size_t *, unsigned char *, size_t, size_t *);
+
+/**
+ * @brief Ends the input of a stream and collects the remaining output.
+ *
+ * Must be called again while it returns 0.
+ *
+ * @param s Stream.
+ * @param out Output buffer.
+ * @param outCap Size of the output buffer.
+ * @param made Pointer to store the number of output bytes produced.
+ * @return 1 once all the output was produced, 0 if there is more output,
+ *         -1 if the input of a decoder ended in the middle of the stream.
+ */
+int streamFinish(HUFFSTREAM *, unsigned char *, size_t, size_t *);
+
+/**
+ * @brief Frees the memory of a stream.
+ *
+ * @param s Stream.
+ * @return void
+ */
+void streamEnd(HUFFSTREAM *);
+
+/**
+ * @brief Compresses everything from one open file to another as a stream.
+ *
+ * Errors are reported on stderr, since the output may be stdout.
+ *
+ * @param in Input file, for example stdin.
+ * @param out Output file, for example stdout.
+ * @return void
+ */
+void compressStream(FILE *, FILE *);
+
+/**
+ * @brief Decompresses a stream from one open file to another.
+ *
+ * @param in Input file, for example stdin.
+ * @param out Output file, for example stdout.
+ * @return void
+ */
+void decompressStream(FILE *, FILE *);
+
+#endif
@@ -0,0 +1,223 @@
+#include "transform.h"
+
+static uint32_t *allocIndex(size_t n)
+{
+    uint32_t *p = (uint32_t *)malloc(n * sizeof(uint32_t));
+    if (p == NULL)
+    {
+        perror("Memory allocation failed");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+uint32_t bwtForward(const unsigned char *in, unsigned char *out, size_t n)
+{
+    if (n == 0)
+        return 0;
+    uint32_t *sa = allocIndex(n);
+    uint32_t *rank = allocIndex(n);
+    uint32_t *tmp = allocIndex(n);
+    uint32_t *cnt = allocIndex(n > 256 ? n : 256);
+    // Sort the rotations by their first two bytes
+    uint32_t *bucket = allocIndex(1 << 16);
+    for (int c = 0; c < (1 << 16); c++)
+        bucket[c] = 0;
+    for (size_t i = 0; i < n; i++)
+        bucket[((uint32_t)in[i] << 8) | in[i + 1 < n ? i + 1 : 0]]++;
+    uint32_t sum = 0;
+    for (int c = 0; c < (1 << 16); c++)
+    {
+        uint32_t t = bucket[c];
+        bucket[c] = sum;
+        sum += t;
+    }
+    for (size_t i = 0; i < n; i++)
+        sa[bucket[((uint32_t)in[i] << 8) | in[i + 1 < n ? i + 1 : 0]]++] = (uint32_t)i;
+    free(bucket);
+    size_t classes = 1;
+    rank[sa[0]] = 0;
+    for (size_t i = 1; i < n; i++)
+    {
+        size_t a = sa[i];
+        size_t b = sa[i - 1];
+        if (in[a] != in[b] || in[a + 1 < n ? a + 1 : 0] != in[b + 1 < n ? b + 1 : 0])
+            classes++;
+        rank[a] = (uint32_t)(classes - 1);
+    }
+    // Prefix doubling: rotations sorted by 2k bytes from two sorts by k bytes
+    for (size_t k = 2; k < n && classes < n; k <<= 1)
+    {
+        // Ordered by their second half, since rotation sa[i] - k continues with sa[i]
+        for (size_t i = 0; i < n; i++)
+            tmp[i] = sa[i] >= k ? sa[i] - (uint32_t)k : sa[i] + (uint32_t)(n - k);
+        // A stable counting sort by the first half completes the order
+        for (size_t c = 0; c < classes; c++)
+            cnt[c] = 0;
+        for (size_t i = 0; i < n; i++)
+            cnt[rank[tmp[i]]]++;
+        sum = 0;
+        for (size_t c = 0; c < classes; c++)
+        {
+            uint32_t t = cnt[c];
+            cnt[c] = sum;
+            sum += t;
+        }
+        for (size_t i = 0; i < n; i++)
+            sa[cnt[rank[tmp[i]]]++] = tmp[i];
+        classes = 1;
+        tmp[sa[0]] = 0;
+        for (size_t i = 1; i < n; i++)
+        {
+            size_t cur = sa[i];
+            size_t prev = sa[i - 1];
+            size_t curNext = cur + k < n ? cur + k : cur + k - n;
+            size_t prevNext = prev + k < n ? prev + k : prev + k - n;
+            if (rank[cur] != rank[prev] || rank[curNext] != rank[prevNext])
+                classes++;
+            tmp[cur] = (uint32_t)(classes - 1);
+        }
+        uint32_t *t = rank;
+        rank = tmp;
+        tmp = t;
+    }
+    uint32_t primary = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (sa[i] == 0)
+            primary = (uint32_t)i;
+        out[i] = in[sa[i] == 0 ? n - 1 : sa[i] - 1];
+    }
+    free(sa);
+    free(rank);
+    free(tmp);
+    free(cnt);
+    return primary;
+}
+
+int bwtInverse(const unsigned char *in, unsigned char *out, size_t n, uint32_t primary)
+{
+    if (n == 0)
+        return 0;
+    if (primary >= n || n > BWTMAX)
+        return -1;
+    // The upper 24 bits of next[j] are the row of the rotation one byte
+    // further than row j, and the lower 8 the last byte of row j, so every
+    // step of the walk costs a single cache miss
+    uint32_t *next = allocIndex(n);
+    uint32_t start[256];
+    for (int c = 0; c < 256; c++)
+        start[c] = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        start[in[i]]++;
+        next[i] = in[i];
+    }
+    uint32_t sum = 0;
+    for (int c = 0; c < 256; c++)
+    {
+        uint32_t t = start[c];
+        start[c] = sum;
+        sum += t;
+    }
+    for (size_t i = 0; i < n; i++)
+        next[start[in[i]]++] |= (uint32_t)i << 8;
+    uint32_t j = next[primary] >> 8;
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t e = next[j];
+        out[i] = (unsigned char)e;
+        j = e >> 8;
+    }
+    free(next);
+    return 0;
+}
+
+void mtfForward(unsigned char *buf, size_t n)
+{
+    unsigned char order[256];
+    for (int c = 0; c < 256; c++)
+        order[c] = (unsigned char)c;
+    for (size_t i = 0; i < n; i++)
+    {
+        // Shift the list down while looking for the byte
+        unsigned char c = buf[i];
+        unsigned char prev = order[0];
+        int j = 0;
+        while (prev != c)
+        {
+            unsigned char t = order[++j];
+            order[j] = prev;
+            prev = t;
+        }
+        order[0] = c;
+        buf[i] = (unsigned char)j;
+    }
+}
+
+void mtfInverse(unsigned char *buf, size_t n)
+{
+    unsigned char order[256];
+    for (int c = 0; c < 256; c++)
+        order[c] = (unsigned char)c;
+    for (size_t i = 0; i < n; i++)
+    {
+        int j = buf[i];
+        unsigned char c = order[j];
+        for (; j > 0; j--)
+            order[j] = order[j - 1];
+        order[0] = c;
+        buf[i] = c;
+    }
+}
+
+size_t rleForward(const unsigned char *in, size_t n, unsigned char *out)
+{
+    size_t o = 0;
+    size_t i = 0;
+    while (i < n)
+    {
+        unsigned char c = in[i];
+        size_t run = 1;
+        while (i + run < n && in[i + run] == c && run < RLERUN + 255)
+            run++;
+        i += run;
+        if (run < RLERUN)
+        {
+            for (size_t r = 0; r < run; r++)
+                out[o++] = c;
+            continue;
+        }
+        for (int r = 0; r < RLERUN; r++)
+            out[o++] = c;
+        out[o++] = (unsigned char)(run - RLERUN);
+    }
+    return o;
+}
+
+long long rleInverse(const unsigned char *in, size_t n, unsigned char *out, size_t cap)
+{
+    size_t o = 0;
+    size_t i = 0;
+    int run = 0;
+    int last = -1;
+    while (i < n)
+    {
+        unsigned char c = in[i++];
+        if (o == cap)
+            return -1;
+        out[o++] = c;
+        run = c == last ? run + 1 : 1;
+        last = c;
+        if (run < RLERUN)
+            continue;
+        // RLERUN equal bytes are always followed by a count
+        if (i == n || cap - o < in[i])
+            return -1;
+        memset(out + o, c, in[i]);
+        o += in[i++];
+        run = 0;
+        last = -1;
+    }
+    return (long long)o;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file transform.h
+ * @brief Reversible transforms applied to blocks before Huffman coding.
+ *
+ * Huffman coding spends at least one bit on every byte, however repetitive
+ * the input is. These transforms reshape a block so that the coder sees
+ * fewer and more skewed symbols:
+ *
+ * - BWT, the Burrows-Wheeler transform, sorts all rotations of the block
+ *   and keeps their last bytes, which groups bytes with similar contexts.
+ *   It also returns the row of the unrotated block, needed to undo it.
+ * - MTF, move-to-front, replaces every byte by its position in a list of
+ *   recently seen bytes, so the runs and clusters of the BWT become runs of
+ *   small numbers.
+ * - RLE, run-length coding: after RLERUN equal bytes a count byte tells how
+ *   many more follow, at most 255.
+ *
+ * They are applied in that order, every one optional, and undone in the
+ * reverse order. BWT and MTF keep the length of the block; RLE can grow it
+ * by a quarter at most (see RLEBOUND).
+ *
+ * @see block.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef TRANSFORMH
+#define TRANSFORMH
+
+/** Number of equal bytes after which RLE writes a count byte. */
+#define RLERUN 4
+
+/** Largest block bwtInverse takes, so a row and a byte fit in 32 bits. */
+#define BWTMAX ((size_t)1 << 24)
+
+/** Largest size of n bytes after RLE. */
+#define RLEBOUND(n) ((n) + (n) / RLERUN + RLERUN)
+
+/**
+ * @brief Burrows-Wheeler transform of a block.
+ *
+ * @param in Block of n bytes.
+ * @param out Buffer of n bytes for the last column of the sorted rotations.
+ * @param n Number of bytes, at most BWTMAX to be undone.
+ * @return The row of the sorted rotations that holds the block itself.
+ */
+uint32_t bwtForward(const unsigned char *, unsigned char *, size_t);
+
+/**
+ * @brief Undoes the Burrows-Wheeler transform.
+ *
+ * @param in Last column of n bytes.
+ * @param out Buffer of n bytes for the block.
+ * @param n Number of bytes, at most BWTMAX.
+ * @param primary Row returned by bwtForward.
+ * @return 0 on success, -1 if primary or n is out of range.
+ */
+int bwtInverse(const unsigned char *, unsigned char *, size_t, uint32_t);
+
+/**
+ * @brief Move-to-front transform, in place.
+ *
+ * @param buf Bytes to transform.
+ * @param n Number of bytes.
+ * @return void
+ */
+void mtfForward(unsigned char *, size_t);
+
+/**
+ * @brief Undoes the move-to-front transform, in place.
+ *
+ * @param buf Bytes to transform back.
+ * @param n Number of bytes.
+ * @return void
+ */
+void mtfInverse(unsigned char *, size_t);
+
+/**
+ * @brief Run-length codes a block.
+ *
+ * @param in Block of n bytes.
+ * @param n Number of bytes.
+ * @param out Buffer of at least RLEBOUND(n) bytes.
+ * @return The number of bytes written to out.
+ */
+size_t rleForward(const unsigned char *, size_t, unsigned char *);
+
+/**
+ * @brief Undoes run-length coding.
+ *
+ * @param in Run-length coded bytes.
+ * @param n Number of coded bytes.
+ * @param out Buffer for the decoded bytes.
+ * @param cap Size of out.
+ * @return The number of bytes decoded, -1 if they don't fit in cap.
+ */
+long long rleInverse(const unsigned char *, size_t, unsigned char *, size_t);
+
+#endif